@@ -1,4 +1,3 @@
-
 /**
  ******************************************************************************
  * 
@@ -38,8 +37,16 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <tlhelp32.h>
+#include <psapi.h>
+#include <wct.h>
+#include <powrprof.h>
+#include <setupapi.h>
+#include <initguid.h>
+#include <emi.h>
 #include "llist.h"
+#include "srvctame_plugin.h"
 
 /** @addtogroup SRVC_TAME
   * @{
@@ -56,6 +63,69 @@
 #define SRVC_TAME_SERVICE_DISPLAY_NAME "Process Tamer"                  /* Service default display name */
 #define SRVC_TAME_SERVICE_DESCRIPTION  "Windows process taming service" /* Service default description */
 #define SRVC_TAME_INTERVAL             10000                            /* 10 seconds */
+#define SRVC_TAME_HASH_FILE            "SrvcTame.hash"                  /* Persistent executable hash cache */
+#define SRVC_TAME_HASH_MAGIC           0x43485453                       /* 'STHC' */
+#define SRVC_TAME_HASH_BUCKETS         256                              /* Hash cache buckets, power of 2 */
+#define SRVC_TAME_HASH_CHUNK           65536                            /* File read chunk while hashing */
+#define SRVC_TAME_SHA256_SIZE          32                               /* SHA-256 digest length in bytes */
+#define SRVC_TAME_PRIO_MAX             3                                /* Highest .INI priority level, above normal */
+#define SRVC_TAME_NAME_SLOTS_MIN       64                               /* Minimal name index size, power of 2 */
+#define SRVC_TAME_STATS_FILE           "SrvcTame.stats"                 /* Exported counters, .INI format */
+#define SRVC_TAME_STATS_INTERVAL       10000                            /* 10 seconds between counters exports */
+#define SRVC_TAME_HANDLE_CACHE_AUTO    -1                               /* Size the handle cache after the tamed set */
+#define SRVC_TAME_HANDLE_CACHE_MIN     32                               /* Auto sized handle cache lower bound */
+#define SRVC_TAME_HANDLE_CACHE_MAX     4096                             /* Handle cache upper bound */
+#define SRVC_TAME_HANDLE_BUCKETS       256                              /* Handle cache PID buckets, power of 2 */
+#define SRVC_TAME_STATE_FILE           "SrvcTame.state"                 /* Memory mapped tamed processes table */
+#define SRVC_TAME_STATE_MAGIC          0x53545453                       /* 'STTS' */
+#define SRVC_TAME_STATE_VERSION        7                                /* Bumped whenever the entry layout changes */
+#define SRVC_TAME_STATE_ENTRIES        8192                             /* Tamed processes table capacity */
+#define SRVC_TAME_STATE_FROZEN         256                              /* Frozen processes recorded, thawed by the next run */
+#define SRVC_TAME_STOP_WAIT_HINT       10000                            /* Milliseconds the service may take to stop */
+#define SRVC_TAME_PID_PAGE             1024                             /* PIDs per page of the PID table, power of 2 */
+#define SRVC_TAME_PROTECT_WS_MIN       (8 * 1024 * 1024)                /* Self protection: working set kept resident */
+#define SRVC_TAME_PROTECT_WS_MAX       (64 * 1024 * 1024)               /* Self protection: working set soft upper bound */
+#define SRVC_TAME_PROTECTED_MAX        64                               /* Protected processes considered per sweep */
+#define SRVC_TAME_PLUGINS_MAX          16                               /* Plugins loaded at once */
+#define SRVC_TAME_PLUGIN_BUDGET        50                               /* Default batch handler budget in milliseconds */
+#define SRVC_TAME_PLUGIN_OVERRUNS      3                                /* Consecutive overruns before a plugin is disabled */
+#define SRVC_TAME_PLUGIN_MISSING       -2                               /* Entry refers to a plugin that is not loaded */
+#define SRVC_TAME_HOG_CPU              0                                /* Default hog threshold of a job, percent of one processor, 0 disables */
+#define SRVC_TAME_TRIM_IDLE_CPU        1                                /* Default idle threshold of a process to trim, percent of one processor */
+#define SRVC_TAME_SERIALIZE_IDLE_CPU   2                                /* Default idle threshold of a serialized process, percent of one processor */
+#define SRVC_TAME_SERIALIZE_IDLE_IO    64                               /* Default idle threshold of a serialized process, KB/s */
+#define SRVC_TAME_THREAD_BUCKETS       1024                             /* Thread name cache TID buckets, power of 2 */
+#define SRVC_TAME_THREAD_NAME          64                               /* Thread names longer than this are truncated */
+#define SRVC_TAME_CPU_KP               0.5                              /* CPU cap controller: proportional gain */
+#define SRVC_TAME_CPU_KI               0.2                              /* CPU cap controller: integral gain, per check interval */
+#define SRVC_TAME_CPU_CAP_MIN          1.0                              /* CPU cap controller: lowest cap, percent of the machine */
+#define SRVC_TAME_CPU_CAP_STEP         10.0                             /* CPU cap controller: largest change per check interval, percent */
+#define SRVC_TAME_CHECK_SETTLE         30                               /* Self check: check intervals the CPU cap may take to settle */
+#define SRVC_TAME_CHECK_PASSES         20                               /* Self check: simulated sweeps over the running processes */
+#define SRVC_TAME_CHECK_SCAN_MB        256                              /* Self check: file read over and over by the background scanner */
+#define SRVC_TAME_CHECK_READ_MB        64                               /* Self check: file read at random by the foreground */
+#define SRVC_TAME_CHECK_IO_MS          3000                             /* Self check: foreground random reads, per I/O priority */
+#define SRVC_TAME_CHECK_IO_READS       65536                            /* Self check: foreground read latencies kept */
+#define SRVC_TAME_CHECK_AGENTS         3                                /* Self check: background agents taking turns */
+#define SRVC_TAME_CHECK_AGENT_MS       12000                            /* Self check: agents run for this long, alone then serialized */
+#define SRVC_TAME_CHECK_LOOKUPS        3000000                          /* Self check: PID lookups timed per table size */
+#define SRVC_TAME_CHECK_MEMORY_MB      256                              /* Self check: memory touched by the idle agent to trim */
+#define SRVC_TAME_CHECK_SLICED         8                                /* Self check: agents moved into a stand-in slice */
+#define SRVC_TAME_SLICE_NAME           "SrvcTame.Background"            /* Default name of the shared background job object */
+#define SRVC_TAME_SLICE_WS_MIN         (1024 * 1024)                    /* Background job: working set floor when a ceiling is set */
+#define SRVC_TAME_COALESCE_MIN         1                                /* Process creation and exit bursts: shortest coalescing window, ms */
+#define SRVC_TAME_COALESCE_MAX         50                               /* Process creation and exit bursts: default longest wait before a sweep, ms */
+#define SRVC_TAME_ENERGY_METERS        8                                /* Energy meter devices read at once */
+#define SRVC_TAME_ENERGY_BASELINE      30000                            /* Default energy baseline window before the first sweep, ms */
+#define SRVC_TAME_LINT_PASSES          100                              /* Timed matcher passes over the process table when linting */
+#define SRVC_TAME_SWEEP_THREADS_AUTO   -1                               /* First sweep classification threads: one per processor */
+#define SRVC_TAME_SWEEP_THREADS_MAX    16                               /* First sweep classification threads upper bound */
+#define SRVC_TAME_PROCESS_ACCESS       (PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_SET_INFORMATION | PROCESS_SET_QUOTA | SYNCHRONIZE)
+
+/* NtSetInformationProcess() / NtQueryInformationProcess() I/O priority class and hints */
+#define TAMER_PROCESS_IO_PRIORITY      33
+#define TAMER_IO_PRIORITY_VERY_LOW     0
+#define TAMER_IO_PRIORITY_NORMAL       2
 
 /**
   * @}
@@ -66,32 +136,583 @@
   * @{
   */
 
+/*! @brief  What should be done to a process, only the fields flagged in 'fields' are meaningful */
+typedef struct __Tamer_Action
+{
+    uint32_t                       fields;
+    DWORD                          priorityClass;
+    DWORD_PTR                      affinity;
+    bool                           ecoQoS;
+    ULONG                          ioPriority;
+    ULONG                          memoryPriority;
+    int                            plugin; /* Index in the loaded plugins, negative when none */
+    int                            threadPriority;
+    char                          *threadPattern; /* Owned by the configuration entry */
+    const struct __Tamer_ProcList *limitRule;     /* Entry whose instances limit applies */
+    const struct __Tamer_ProcList *serializeRule; /* Entry naming the serialize group */
+    const struct __Tamer_ProcList *jobRule;       /* Entry whose job object receives the process */
+
+} Tamer_Action;
+
 typedef struct __Tamer_ProcList
 {
     char                     procName[128];
+    char                     procPath[MAX_PATH];          /* Executable path prefix, empty when not used */
+    char                     threadPattern[128];          /* Thread name pattern, empty when not used */
+    uint32_t                 maxInstances;                /* Matching processes allowed to run at once, 0 for no limit */
+    char                     serializeGroup[64];          /* Group whose members take turns to run, empty when not used */
+    uint32_t                 maxProcesses;                /* Active processes limit of the job object, 0 for no limit */
+    bool                     account;                     /* Contain matching processes in a job for exit accounting alone */
+    uint32_t                 cpuTarget;                   /* Machine processor use the job CPU cap is steered to, percent, 0 when not used */
+    uint8_t                  hash[SRVC_TAME_SHA256_SIZE]; /* Executable SHA-256, valid when hasHash is set */
+    bool                     hasHash;
+    bool                     exclude; /* Matching processes are left alone */
     int                      priority;
+    int                      precedence; /* Explicit precedence, higher wins */
+    int                      index;      /* Position in the configuration file */
+    Tamer_Action             action;
     struct __Tamer_ProcList *next;
 
 } Tamer_Proc;
 
+/*! @brief  Decision table row: the candidate entries for one executable name, in precedence order */
+typedef struct __Tamer_NameSlot
+{
+    char      procName[128]; /* Lower case, empty for a free slot */
+    int      *rules;         /* Positions in the matcher 'rules' array */
+    uint32_t *remaining;     /* Action fields the candidates from this position on could still provide */
+    int       count;
+
+} Tamer_NameSlot;
+
+/*! @brief  Compiled form of the process list, rebuilt whenever the configuration changes */
+typedef struct __Tamer_Matcher
+{
+    Tamer_Proc    **rules; /* All entries in precedence order */
+    int             ruleCount;
+    Tamer_NameSlot *slots; /* Open addressing index over the entry names */
+    int             slotCount;
+    Tamer_NameSlot  unnamed; /* Row used for names that are not in the index */
+
+} Tamer_Matcher;
+
+/*! @brief  On-disk identity of an executable: volume, file index and last write time */
+typedef struct __Tamer_FileKey
+{
+    uint32_t volume;
+    uint32_t reserved;
+    uint64_t fileIndex;
+    uint64_t lastWrite;
+
+} Tamer_FileKey;
+
+/*! @brief  Hash cache entry, also the persistent file record layout (minus 'next') */
+typedef struct __Tamer_HashEntry
+{
+    Tamer_FileKey             key;
+    uint8_t                   hash[SRVC_TAME_SHA256_SIZE];
+    struct __Tamer_HashEntry *next;
+
+} Tamer_HashEntry;
+
+/*! @brief  Pending hash request handed to the background hashing thread */
+typedef struct __Tamer_HashJob
+{
+    Tamer_FileKey           key;
+    char                    path[MAX_PATH];
+    struct __Tamer_HashJob *next;
+
+} Tamer_HashJob;
+
+/*! @brief  Executable identity cache state */
+typedef struct __Tamer_HashCache
+{
+    Tamer_HashEntry *buckets[SRVC_TAME_HASH_BUCKETS];
+    Tamer_HashJob   *jobs;
+    CRITICAL_SECTION lock;
+    HANDLE           hWake;
+    HANDLE           hThread;
+    char             filePath[MAX_PATH];
+    bool             locked; /* Lock initialized, kept across a failed start */
+    bool             loaded;
+    bool             dirty;
+
+} Tamer_HashCache;
+
+/*! @brief  Identity of a running process, resolved on demand during a sweep */
+typedef struct __Tamer_ProcIdentity
+{
+    bool    pathQueried;
+    bool    pathValid;
+    bool    hashQueried;
+    bool    hashValid;
+    char    path[MAX_PATH];
+    uint8_t hash[SRVC_TAME_SHA256_SIZE];
+
+} Tamer_ProcIdentity;
+
+/*! @brief  Identity of a running process kept across sweeps, the held handle keeps its PID from being reused */
+typedef struct __Tamer_PidIdentity
+{
+    DWORD                       pid;
+    HANDLE                      hProcess;
+    uint32_t                    seen; /* Last sweep that found the process */
+    Tamer_ProcIdentity          ident;
+    struct __Tamer_PidIdentity *prev, *next;
+
+} Tamer_PidIdentity;
+
+/*! @brief  SHA-256 running context */
+typedef struct __Tamer_SHA256
+{
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t  block[64];
+    size_t   used;
+
+} Tamer_SHA256;
+
 typedef struct __Tamer_Config
 {
-    char        serviceDispalyName[256];
-    char        serviceDescription[256];
-    char        filePath[MAX_PATH];
-    uint32_t    interval;
-    uint32_t    crc32;
-    Tamer_Proc *procList;
+    char          serviceDispalyName[256];
+    char          serviceDescription[256];
+    char          filePath[MAX_PATH];
+    char          dataPath[MAX_PATH];
+    uint32_t      interval;
+    uint32_t      statsInterval;
+    int           handleCacheSize;
+    bool          selfProtect;
+    uint32_t      pluginBudget;         /* Milliseconds a plugin batch handler may take */
+    uint32_t      inversionThreads;     /* Protected threads whose wait chain is inspected per sweep, 0 disables */
+    int           sweepThreads;         /* Threads classifying the processes of the first sweep, 1 disables sharding */
+    uint32_t      coalesceMax;          /* Longest wait between a process creation and its sweep, ms, 0 sweeps on the interval only */
+    char          energyFile[MAX_PATH]; /* Stand-in energy counter, microjoules, replaces the energy meters when set */
+    uint32_t      energyBaseline;       /* Energy measured for this long before anything is tamed, ms, 0 disables */
+    char          sliceName[128];       /* Shared background job object */
+    uint32_t      sliceCpuWeight;       /* Its processor weight, 1 to 9, 0 when not set */
+    uint32_t      sliceMemoryHigh;      /* Working set ceiling of its processes, MB, 0 when not set */
+    uint32_t      hogCpu;               /* Above this processor use (percent of one processor) a job hogs the machine, 0 disables */
+    uint32_t      trimIdleCpu;          /* Below this processor use (percent of one processor) a process to trim is idle */
+    uint32_t      serializeIdleCpu;     /* Below this processor use (percent of one processor) a serialized process is idle */
+    uint32_t      serializeIdleIo;      /* and below this I/O rate (KB/s) */
+    char          protectedNames[SRVC_TAME_PROTECTED_MAX][128];
+    int           protectedCount;
+    uint32_t      crc32;
+    Tamer_Proc   *procList;
+    Tamer_Matcher matcher;
+    DWORD_PTR     housekeeping; /* Union of the processors tamed processes are confined to */
+    bool          threadRules;  /* Some entries target threads by name */
 
 } Tamer_Config;
 
+/*! @brief  Cached process handle, kept both in a PID bucket and in the LRU list */
+typedef struct __Tamer_HandleEntry
+{
+    DWORD                       pid;
+    HANDLE                      hProcess;
+    uint64_t                    startTime; /* Process creation time, tells PID reuse apart */
+    uint32_t                    round;     /* Last sweep that used the handle */
+    struct __Tamer_HandleEntry *prev, *next; /* LRU list, most recent first */
+    struct __Tamer_HandleEntry *hnext;       /* PID bucket chain */
+
+} Tamer_HandleEntry;
+
+/*! @brief  Bounded process handle cache */
+typedef struct __Tamer_HandleCache
+{
+    Tamer_HandleEntry *buckets[SRVC_TAME_HANDLE_BUCKETS];
+    Tamer_HandleEntry *lru;
+    int                count;
+    int                capacity;
+    uint64_t           hits;
+    uint64_t           misses;
+    uint64_t           evictions;
+    uint64_t           stale; /* Cached handles whose process had exited */
+
+} Tamer_HandleCache;
+
+/*! @brief  Tamed process record, as laid out in the state file */
+typedef struct __Tamer_StateEntry
+{
+    uint32_t pid;            /* Process ID */
+    uint32_t priorityClass;  /* Priority class before the process was first tamed */
+    uint64_t startTime;      /* Process creation time */
+    uint32_t level;          /* Times the action had to be applied again after being reverted */
+    uint32_t round;          /* Last sweep that matched the process */
+    uint32_t lifted;         /* Last sweep that found a protected thread waiting on the process */
+    uint32_t applied;        /* TAMER_ACTION_xxx other than the priority currently in effect */
+    uint64_t affinity;       /* Affinity mask before the process was first confined */
+    uint32_t ioPriority;     /* I/O priority hint before the process was first tamed */
+    uint32_t memoryPriority; /* Memory priority before the process was first tamed */
+    uint64_t cpuTime;        /* Processor time at the last sweep, 100ns units, tells idle processes */
+    uint32_t reported;       /* Dry run: digest of the last printed decision, 0 when never printed */
+    uint32_t reserved;
+
+} Tamer_StateEntry;
+
+/*! @brief  Process frozen by an instances limit or a serialize group, as laid out in the state file */
+typedef struct __Tamer_StateFrozen
+{
+    uint32_t pid;
+    uint32_t reserved;
+    uint64_t startTime; /* Process creation time */
+
+} Tamer_StateFrozen;
+
+/*! @brief  State file header, followed by SRVC_TAME_STATE_ENTRIES entries, the first 'count' of them in use */
+typedef struct __Tamer_StateHeader
+{
+    uint32_t          magic;
+    uint32_t          version;
+    uint32_t          capacity;
+    uint32_t          count;
+    uint32_t          frozenCount;
+    uint32_t          reserved;
+    Tamer_StateFrozen frozen[SRVC_TAME_STATE_FROZEN]; /* Survive a crash, the next run thaws them */
+
+} Tamer_StateHeader;
+
+/*! @brief  Page of the PID table, hot per PID fields as parallel arrays */
+typedef struct __Tamer_PidPage
+{
+    uint32_t           slot[SRVC_TAME_PID_PAGE];  /* State entry index + 1, 0 when the process is not tamed */
+    uint32_t           seen[SRVC_TAME_PID_PAGE];  /* Last sweep that found the PID in the snapshot */
+    Tamer_PidIdentity *ident[SRVC_TAME_PID_PAGE]; /* Resolved path and digest, NULL until a rule needed them */
+
+} Tamer_PidPage;
+
+/*! @brief  Directly PID indexed table, pages are allocated as PIDs show up */
+typedef struct __Tamer_PidTable
+{
+    Tamer_PidPage    **pages; /* Directory, grown to cover the highest PID seen */
+    uint32_t           pageCount;
+    uint32_t           allocated; /* Pages allocated */
+    Tamer_PidIdentity *identities; /* Identities held, released once their process is gone */
+    uint32_t           identityCount;
+    uint64_t           identityHits; /* Sweeps that reused an identity instead of resolving it again */
+
+} Tamer_PidTable;
+
+/*! @brief  Tamed processes table, lives in a memory mapped file to survive restarts */
+typedef struct __Tamer_State
+{
+    HANDLE             hFile;
+    HANDLE             hMapping;
+    Tamer_StateHeader *header;
+    Tamer_StateEntry  *entries;
+    uint32_t           resumed;  /* Entries carried over from the previous run */
+    uint32_t           restored; /* Processes given back their original priority */
+    uint32_t           thawed;   /* Processes a previous run left frozen */
+
+} Tamer_State;
+
+/*! @brief  Priority inversion relief state */
+typedef struct __Tamer_Inversion
+{
+    HWCT     hWct;
+    uint32_t cursor;    /* Round robin position among the protected threads */
+    uint64_t inspected; /* Wait chains retrieved */
+    uint64_t lifts;     /* Tamed processes lifted because a protected thread waited on them */
+    uint64_t thaws;     /* Frozen processes thawed for the same reason */
+    uint64_t ticks;     /* Time spent, in performance counter ticks */
+
+} Tamer_Inversion;
+
+/*! @brief  CallNtPowerInformation(ProcessorInformation) output, not declared by the SDK headers */
+typedef struct __Tamer_ProcessorPower
+{
+    ULONG Number;
+    ULONG MaxMhz;
+    ULONG CurrentMhz;
+    ULONG MhzLimit;
+    ULONG MaxIdleState;
+    ULONG CurrentIdleState;
+
+} Tamer_ProcessorPower;
+
+typedef NTSTATUS(WINAPI *Tamer_NtSetInformationProcess)(HANDLE, ULONG, PVOID, ULONG);
+typedef NTSTATUS(WINAPI *Tamer_NtQueryInformationProcess)(HANDLE, ULONG, PVOID, ULONG, PULONG);
+typedef NTSTATUS(WINAPI *Tamer_NtSuspendProcess)(HANDLE);
+typedef HRESULT(WINAPI *Tamer_GetThreadDescription)(HANDLE, PWSTR *);
+
+/*! @brief  Native API entry points without an import library, resolved from ntdll.dll at run time */
+typedef struct __Tamer_NtApi
+{
+    Tamer_NtSetInformationProcess   SetInformationProcess;
+    Tamer_NtQueryInformationProcess QueryInformationProcess;
+    Tamer_NtSuspendProcess          SuspendProcess;
+    Tamer_NtSuspendProcess          ResumeProcess;
+    Tamer_GetThreadDescription      GetThreadDescription; /* kernel32, Windows 10 1607 and later */
+    bool                            loaded;
+
+} Tamer_NtApi;
+
+/*! @brief  Loaded plugin, its pending batch and its timing */
+typedef struct __Tamer_Plugin
+{
+    HMODULE                 hModule;
+    SrvcTame_Plugin         api;
+    SrvcTame_PluginProcess *batch;
+    size_t                  batchCount;
+    size_t                  batchSize;
+    uint64_t                calls;
+    uint64_t                processes;
+    uint64_t                matches;    /* Match predicate calls */
+    uint64_t                sweepTicks; /* Time spent in the match predicate during this sweep */
+    uint64_t                ticks;      /* Total time spent in the plugin, performance counter ticks */
+    uint64_t                maxTicks;   /* Longest sweep, match predicate and batch */
+    uint32_t                overruns;   /* Consecutive sweeps over budget */
+    bool                    disabled;
+
+} Tamer_Plugin;
+
+/*! @brief  Thread name cache entry, names are read once per thread */
+typedef struct __Tamer_ThreadEntry
+{
+    DWORD                       tid;
+    DWORD                       pid;
+    uint32_t                    round;    /* Last sweep that saw the thread in a targeted process */
+    bool                        applied;  /* The thread priority was changed */
+    int                         priority; /* Thread priority before it was changed */
+    char                        name[SRVC_TAME_THREAD_NAME];
+    struct __Tamer_ThreadEntry *next;
+
+} Tamer_ThreadEntry;
+
+/*! @brief  Process whose threads are to be tamed by name this sweep */
+typedef struct __Tamer_ThreadTarget
+{
+    DWORD       pid;
+    int         priority;
+    const char *pattern;
+
+} Tamer_ThreadTarget;
+
+/*! @brief  Thread level taming state */
+typedef struct __Tamer_Threads
+{
+    Tamer_ThreadEntry  *buckets[SRVC_TAME_THREAD_BUCKETS];
+    Tamer_ThreadTarget *targets;
+    int                 targetCount;
+    int                 targetSize;
+    uint64_t            lookups; /* Thread names read */
+    uint64_t            tamed;   /* Thread priorities changed */
+
+} Tamer_Threads;
+
+struct __Tamer_LimitGroup;
+
+/*! @brief  Live process counted against an instances limit */
+typedef struct __Tamer_LimitInstance
+{
+    DWORD                         pid;
+    HANDLE                        hProcess; /* Held open, the PID cannot be reused meanwhile */
+    HANDLE                        hWait;    /* Exit notification */
+    ULONGLONG                     frozenTick;
+    ULONGLONG                     sampleTick; /* Serialize groups: last activity sample */
+    uint64_t                      cpuTime;    /* Processor time at the last sample, 100ns units */
+    uint64_t                      ioBytes;    /* Bytes transferred at the last sample */
+    uint32_t                      lifted;      /* Last sweep that thawed it for a protected thread waiting on it */
+    bool                          frozen;
+    bool                          exited;
+    struct __Tamer_LimitGroup    *group;       /* NULL once detached from its group */
+    struct __Tamer_LimitInstance *prev, *next; /* Group instances, in arrival order */
+
+} Tamer_LimitInstance;
+
+/*! @brief  Processes matching an entry with an instances limit, or the members of a serialize group */
+typedef struct __Tamer_LimitGroup
+{
+    int                        index; /* Configuration entry defining the limit, 0 for a serialize group */
+    bool                       serialize;
+    char                       name[128];
+    uint32_t                   max;
+    uint32_t                   running;
+    uint32_t                   queued;
+    Tamer_LimitInstance       *instances;
+    uint64_t                   frozen;  /* Processes frozen since start */
+    uint64_t                   thawed;  /* Processes thawed as earlier ones exited */
+    uint64_t                   maxWait; /* Longest time a process stayed frozen, milliseconds */
+    uint64_t                   rotations; /* Serialize groups: turns handed over because the active member went idle */
+    uint64_t                   contended; /* Serialize groups: time the active member was busy while others waited, milliseconds */
+    struct __Tamer_LimitGroup *next;
+
+} Tamer_LimitGroup;
+
+/*! @brief  Instances limiter, exit notifications run on the thread pool */
+typedef struct __Tamer_Limiter
+{
+    Tamer_LimitGroup *groups;
+    CRITICAL_SECTION  lock;
+    bool              initialized;
+
+} Tamer_Limiter;
+
+/*! @brief  Process of a job, held open so its accounting survives its exit */
+typedef struct __Tamer_JobProcess
+{
+    DWORD                      pid;
+    HANDLE                     hProcess;
+    struct __Tamer_JobProcess *next;
+
+} Tamer_JobProcess;
+
+/*! @brief  Job object holding the process trees matched by an entry */
+typedef struct __Tamer_Job
+{
+    int                 index; /* Configuration entry, also the completion key of its notifications */
+    char                name[128];
+    HANDLE              hJob;
+    uint32_t            maxProcesses;
+    uint64_t            spawned;   /* Processes created in the job */
+    uint64_t            limitHits; /* Process creations refused by the active processes limit */
+    uint64_t            full;      /* Assignments skipped, the job was at its active processes limit */
+    Tamer_JobProcess   *processes; /* Live processes of the job */
+    uint64_t            exits;
+    uint64_t            shortLived; /* Exited processes that lived less than the time between two checks */
+    uint64_t            shortCpu;   /* Processor time of those, which no sweep could have sampled, 100ns units */
+    uint64_t            exitCpu;    /* Processor time of the exited processes, 100ns units */
+    uint64_t            exitIo;     /* Bytes transferred by the exited processes */
+    ULONGLONG           sampleTick; /* Last accounting read */
+    uint64_t            cpuTime;    /* Processor time of the job at the last read, exited processes included, 100ns units */
+    uint64_t            ioBytes;    /* Bytes transferred by the job at the last read */
+    uint32_t            cpuRate;    /* Processor use over the last check, percent of one processor */
+    bool                hog;        /* The last check found the job above the hog threshold */
+    uint64_t            hogChecks;  /* Checks that found it so */
+    uint64_t            cpuDelta;   /* Processor time over the last check, 100ns units */
+    uint64_t            energy;     /* Estimated share of the package energy, microjoules */
+    uint64_t            ioRate;     /* I/O over the last check, KB/s */
+    uint64_t            peakMemory; /* Peak committed memory of the job, bytes */
+    uint32_t            cpuTarget;  /* Machine processor use to hold, percent, 0 when the job is not capped */
+    double              cpuCap;     /* Current hard cap, percent of the machine */
+    double              integral;   /* Controller integral term */
+    struct __Tamer_Job *next;
+
+} Tamer_Job;
+
+/*! @brief  Job objects of the entries, and the completion port their notifications are queued to */
+typedef struct __Tamer_Jobs
+{
+    Tamer_Job       *list;
+    uint64_t         idleTime;    /* Machine idle time at the last read, 100ns units */
+    uint64_t         busyTime;    /* Machine kernel and user time at the last read, idle included */
+    double           machineUse;  /* Machine processor use over the last check, percent, negative until known */
+    uint64_t         machineBusy; /* Machine processor time, idle excluded, over the last check, 100ns units */
+    ULONGLONG        sampleTick;  /* Last machine times read */
+    HANDLE           hPort;
+    HANDLE           hThread; /* Waits on the port, so exits are accounted as they happen */
+    CRITICAL_SECTION lock;    /* Guards the list against the notifications thread */
+
+} Tamer_Jobs;
+
+/*! @brief  Early sweeps triggered by process creations, bursts coalesced into one sweep */
+typedef struct __Tamer_Wake
+{
+    HANDLE        hEvent;    /* Signaled once per reported process creation or exit */
+    volatile LONG pending;   /* Events reported since the last batch */
+    volatile LONG exited;    /* Of them, exits */
+    uint32_t      window;    /* Current coalescing window, ms */
+    uint64_t      wakes;     /* Sweeps run ahead of the interval */
+    uint64_t      throttled; /* Those held back, the previous sweep was too recent */
+    uint64_t      events;
+    uint64_t      exits;
+    uint64_t      maxBatch;
+
+} Tamer_Wake;
+
+/*! @brief  Shared background job object, processes join it in one batch per sweep */
+typedef struct __Tamer_Slice
+{
+    HANDLE   hJob;
+    char     name[128];
+    DWORD   *queue; /* Processes to move in at the end of the sweep */
+    int      queued;
+    int      queueSize;
+    uint64_t assigned;
+    uint64_t failed; /* Processes that could not join, usually already in an incompatible job */
+
+} Tamer_Slice;
+
+/*! @brief  Slice of the first sweep classified by one worker thread */
+typedef struct __Tamer_SweepShard
+{
+    PROCESSENTRY32     *entries; /* Processes of the slice, sorted by PID */
+    Tamer_Action       *actions; /* Decisions, one per process, written by this shard only */
+    Tamer_ProcIdentity *idents;  /* Identities resolved for the decisions, kept for the next sweeps */
+    size_t              count;
+    HANDLE              hThread;
+
+} Tamer_SweepShard;
+
+/*! @brief  Energy meter device (Energy Meter Interface) */
+typedef struct __Tamer_EnergyMeter
+{
+    HANDLE   hDevice;
+    uint16_t version;
+    uint16_t channelCount;
+    uint64_t channels; /* Channels summed, one bit per channel */
+
+} Tamer_EnergyMeter;
+
+/*! @brief  Energy accounting */
+typedef struct __Tamer_Energy
+{
+    Tamer_EnergyMeter meters[SRVC_TAME_ENERGY_METERS];
+    int               meterCount;
+    bool              opened;
+    uint64_t          last; /* Counter at the last read, microjoules, 0 until known */
+    ULONGLONG         lastTick;
+    uint64_t          total; /* Energy since start, microjoules */
+    uint64_t          totalMs;
+    uint64_t          baseline; /* Energy over the window before the first sweep, microjoules */
+    uint64_t          baselineMs;
+    uint64_t          idleTime; /* Machine idle and total processor times at the last read, 100ns units */
+    uint64_t          busyTime;
+    uint64_t          tamedCpu; /* Processor time of the tamed processes since the last read, 100ns units */
+    uint64_t          tamed;    /* Estimated share of the tamed processes in the energy since start, microjoules */
+
+} Tamer_Energy;
+
 /*! @brief  Module internal data */
 typedef struct __Tamer_GlobalsTypeDef
 {
     SERVICE_STATUS        ServiceStatus;
     SERVICE_STATUS_HANDLE hStatus;
+    HANDLE                hStop;    /* Signaled when the service is asked to stop */
+    HANDLE                hStopped; /* Console: signaled once the loop has let go of every process */
     Tamer_Config         *config;
+    const char           *configFile; /* Configuration file given on the command line, NULL for the default one */
+    Tamer_HashCache       hashCache;
+    Tamer_HandleCache     handleCache;
+    Tamer_State           state;
+    Tamer_PidTable        pids;
+    Tamer_Inversion       inversion;
+    Tamer_NtApi           nt;
+    Tamer_Plugin          plugins[SRVC_TAME_PLUGINS_MAX];
+    int                   pluginCount;
+    Tamer_Threads         threads;
+    Tamer_Limiter         limiter;
+    Tamer_Jobs            jobs;
+    Tamer_Slice           slice;
+    Tamer_Wake            wake;
+    Tamer_Energy          energy;
+    uint32_t              round;     /* Sweeps since start */
+    uint32_t              tamed;     /* Processes acted upon by the last sweep */
+    ULONGLONG             statsTick; /* Last counters export */
+    bool                  protectedMode;
+    uint64_t              latencyCount; /* Newly tamed processes */
+    uint64_t              latencySum;   /* Sum of their spawn to tame latencies, in 100ns units */
+    uint64_t              latencyMax;
+    uint64_t              previousSweep;     /* Start of the previous sweep, FILETIME units */
+    uint64_t              sweepTime;         /* Start of this sweep, FILETIME units */
+    ULONGLONG             sweepTick;         /* Start of this sweep, tick count */
+    uint32_t              sweepGap;          /* Milliseconds since the previous sweep started, the interval until known */
+    uint64_t              trims;             /* Working sets emptied */
+    uint64_t              firstSweepMs;      /* Wall time of the first sweep */
+    int                   firstSweepThreads; /* Threads that classified its processes */
     bool                  serviceMode;
+    bool                  dryRun;        /* Decide and print, never act */
+    uint32_t              dryRunChanges; /* Processes the last dry run sweep would have changed */
 } Tamer_GlobalsTypeDef;
 
 /* Single instance for all globals */
@@ -179,299 +800,6182 @@ static uint32_t Tamer_GetFileCRC(const char *fileName)
     return crc32;
 }
 
-/** 
- * @brief reads the .INI file into the session configuration global.
- * After the first read the function will do nothing if the 
- * configuration crc32 is the same as the previous run crc.
- * @return number of items in the process list or 0 on error.
+/* SHA-256 round constants */
+static const uint32_t Tamer_SHA256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be,
+    0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa,
+    0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85,
+    0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+    0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define TAMER_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ * @brief Process a single 64 bytes block into the SHA-256 state.
+ * @param ctx Pointer to the running SHA-256 context.
+ * @param block Pointer to the 64 bytes block.
  */
 
-static int Tamer_ReadConfig(void)
+static void Tamer_SHA256Block(Tamer_SHA256 *ctx, const uint8_t *block)
 {
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
 
-    int         retVal            = 0;
-    char        iniFile[MAX_PATH] = {0};
-    uint32_t    crc32;
-    Tamer_Proc *el, *tmp;
+    for ( int i = 0; i < 16; i++ )
+        w[i] = ((uint32_t) block[i * 4] << 24) | ((uint32_t) block[i * 4 + 1] << 16) | ((uint32_t) block[i * 4 + 2] << 8) | block[i * 4 + 3];
 
-    do
+    for ( int i = 16; i < 64; i++ )
     {
-        if ( gTamer.config == NULL )
-        {
-            /* First run, allocate the thing */
-            gTamer.config = (Tamer_Config *) malloc(sizeof(Tamer_Config));
-            if ( gTamer.config == 0 )
-                return 0;
+        uint32_t s0 = TAMER_ROTR(w[i - 15], 7) ^ TAMER_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = TAMER_ROTR(w[i - 2], 17) ^ TAMER_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i]        = w[i - 16] + s0 + w[i - 7] + s1;
+    }
 
-            memset(gTamer.config, 0, sizeof(Tamer_Config));
-        }
+    a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
 
-        /* Figure the configuration file name and path */
-        if ( gTamer.config->filePath[0] == 0 )
-        {
-            if ( gTamer.serviceMode == true )
-            {
-                /* When running as a service we expect the .ini to be in the  \Windsows directory. */
-                if ( GetWindowsDirectory(iniFile, MAX_PATH) == 0 )
-                    break;
-            }
-            else
-            {
-                /* When not running as a service we expect the .ini to be in the local path. */
-                if ( GetCurrentDirectory(MAX_PATH, iniFile) == 0 )
-                    break;
-            }
+    for ( int i = 0; i < 64; i++ )
+    {
+        t1 = h + (TAMER_ROTR(e, 6) ^ TAMER_ROTR(e, 11) ^ TAMER_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + Tamer_SHA256K[i] + w[i];
+        t2 = (TAMER_ROTR(a, 2) ^ TAMER_ROTR(a, 13) ^ TAMER_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h  = g, g = f, f = e, e = d + t1;
+        d  = c, c = b, b = a, a = t1 + t2;
+    }
 
-            snprintf(gTamer.config->filePath, MAX_PATH, "%s\\%s", iniFile, SRVC_TAME_INI_FILE);
-        }
+    ctx->state[0] += a, ctx->state[1] += b, ctx->state[2] += c, ctx->state[3] += d;
+    ctx->state[4] += e, ctx->state[5] += f, ctx->state[6] += g, ctx->state[7] += h;
+}
 
-        /* Get the configuration file CRC to see if we have to read it again */
-        crc32 = Tamer_GetFileCRC(gTamer.config->filePath);
-        if ( crc32 == 0 )
-            break;
+/**
+ * @brief Initialize a SHA-256 context.
+ * @param ctx Pointer to the context to initialize.
+ */
 
-        /* If we got a crc that is different from the previous one invalidate the processes list */
-        if ( crc32 != gTamer.config->crc32 )
-        {
+static void Tamer_SHA256Init(Tamer_SHA256 *ctx)
+{
+    static const uint32_t initState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
 
-            /* Get the service display name, description and interval */
+    memset(ctx, 0, sizeof(Tamer_SHA256));
+    memcpy(ctx->state, initState, sizeof(initState));
+}
 
-            gTamer.config->serviceDispalyName[0] = 0;
-            GetPrivateProfileString("Service", "DisplayName", SRVC_TAME_SERVICE_DISPLAY_NAME, gTamer.config->serviceDispalyName,
-                                    sizeof(((Tamer_Config *) 0)->serviceDispalyName) - 1, gTamer.config->filePath);
+/**
+ * @brief Feed data into a SHA-256 context.
+ * @param ctx Pointer to the running context.
+ * @param data Pointer to the data.
+ * @param length Length of the data in bytes.
+ */
 
-            gTamer.config->serviceDescription[0] = 0;
-            GetPrivateProfileString("Service", "Description", SRVC_TAME_SERVICE_DESCRIPTION, gTamer.config->serviceDescription,
-                                    sizeof(((Tamer_Config *) 0)->serviceDescription) - 1, gTamer.config->filePath);
+static void Tamer_SHA256Update(Tamer_SHA256 *ctx, const uint8_t *data, size_t length)
+{
+    ctx->length += length;
 
-            gTamer.config->interval = GetPrivateProfileInt("Service", "Interval", SRVC_TAME_INTERVAL, gTamer.config->filePath);
+    while ( length > 0 )
+    {
+        size_t chunk = sizeof(ctx->block) - ctx->used;
+        if ( chunk > length )
+            chunk = length;
 
-            /* Release the process list */
-            LL_FOREACH_SAFE(gTamer.config->procList, el, tmp)
-            {
-                free(el); /* Release the node */
-            }
+        memcpy(ctx->block + ctx->used, data, chunk);
+        ctx->used += chunk;
+        data += chunk;
+        length -= chunk;
 
-            gTamer.config->procList = NULL;
-            gTamer.config->crc32    = crc32; /* Update our session the current crc32 */
+        if ( ctx->used == sizeof(ctx->block) )
+        {
+            Tamer_SHA256Block(ctx, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
 
-            /* Construct a new list based on the configuration file */
-            char  configEntry[256];
-            int   processIndex = 1;
-            DWORD bufferSize   = sizeof(((Tamer_Proc *) 0)->procName);
+/**
+ * @brief Pad the last block and extract the SHA-256 digest.
+ * @param ctx Pointer to the running context.
+ * @param digest Output buffer of SRVC_TAME_SHA256_SIZE bytes.
+ */
 
-            while ( 1 )
-            {
-                /* Build the list */
-                el = (Tamer_Proc *) malloc(sizeof(Tamer_Proc));
-                if ( el != NULL )
-                {
-                    /* Get the process name */
-                    memset(el, 0, sizeof(Tamer_Proc));
-                    configEntry[0] = 0;
-                    snprintf(configEntry, sizeof(configEntry), "Process%d_Name", processIndex);
-                    if ( GetPrivateProfileString("Processes", configEntry, "", el->procName, bufferSize - 1, gTamer.config->filePath) == 0 )
-                    {
-                        free(el);
-                        el = NULL;
-                        break;
-                    }
-                    /* Get the process tamed priority */
-                    configEntry[0] = 0;
-                    snprintf(configEntry, sizeof(configEntry), "Process%d_Prio", processIndex);
-                    el->priority = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
-                }
+static void Tamer_SHA256Final(Tamer_SHA256 *ctx, uint8_t *digest)
+{
+    uint64_t bits = ctx->length * 8;
+    uint8_t  pad  = 0x80;
 
-                if ( el == NULL )
-                    break;
+    Tamer_SHA256Update(ctx, &pad, 1);
+    pad = 0;
+    while ( ctx->used != 56 )
+        Tamer_SHA256Update(ctx, &pad, 1);
 
-                /* Add to the list */
-                LL_APPEND(gTamer.config->procList, el);
+    for ( int i = 7; i >= 0; i-- )
+    {
+        pad = (uint8_t) (bits >> (i * 8));
+        Tamer_SHA256Update(ctx, &pad, 1);
+    }
 
-                processIndex++;
-            }
-        }
+    for ( int i = 0; i < 8; i++ )
+    {
+        digest[i * 4]     = (uint8_t) (ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t) (ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t) (ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t) (ctx->state[i]);
+    }
+}
 
-        /* Return the items we have in the process list */
-        LL_COUNT(gTamer.config->procList, el, retVal);
+/**
+ * @brief Convert a hex string as found in the .INI file into a SHA-256 digest.
+ * @param text Hex string, 64 characters, case insensitive.
+ * @param hash Output buffer of SRVC_TAME_SHA256_SIZE bytes.
+ * @return true if the string is a well formed digest, false otherwise.
+ */
 
-    } while ( 0 );
+static bool Tamer_HexToHash(const char *text, uint8_t *hash)
+{
+    int nibble;
 
-    return retVal;
+    if ( strlen(text) < SRVC_TAME_SHA256_SIZE * 2 )
+        return false;
+
+    for ( int i = 0; i < SRVC_TAME_SHA256_SIZE * 2; i++ )
+    {
+        char c = text[i];
+        if ( c >= '0' && c <= '9' )
+            nibble = c - '0';
+        else if ( c >= 'a' && c <= 'f' )
+            nibble = c - 'a' + 10;
+        else if ( c >= 'A' && c <= 'F' )
+            nibble = c - 'A' + 10;
+        else
+            return false;
+
+        if ( (i & 1) == 0 )
+            hash[i / 2] = (uint8_t) (nibble << 4);
+        else
+            hash[i / 2] |= (uint8_t) nibble;
+    }
+
+    return true;
 }
 
 /**
- * @brief Uninstalls the service.
- * @param serviceName Name of the service to uninstall.
- * @retval int EXIT_SUCCESS on success, EXIT_FAILURE on failure.
+ * @brief Calculate the SHA-256 of a file, reading it in chunks.
+ * @param fileName Full path of the file to hash.
+ * @param hash Output buffer of SRVC_TAME_SHA256_SIZE bytes.
+ * @return true on success, false otherwise.
  */
 
-static int Tamer_ServiceUninstall(const char *serviceName)
+static bool Tamer_HashFile(const char *fileName, uint8_t *hash)
 {
-    int       retVal     = EXIT_FAILURE;
-    SC_HANDLE hSCManager = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+    FILE        *file   = NULL;
+    uint8_t     *buffer = NULL;
+    bool         retVal = false;
+    size_t       bytesRead;
+    Tamer_SHA256 ctx;
 
-    if ( hSCManager && serviceName )
+    do
     {
-        SC_HANDLE hService = OpenService(hSCManager, serviceName, SERVICE_STOP | DELETE);
-        if ( hService )
-        {
-            SERVICE_STATUS status;
-            if ( ControlService(hService, SERVICE_CONTROL_STOP, &status) )
-            {
+        file = fopen(fileName, "rb");
+        if ( file == NULL )
+            break;
 
-                Sleep(1000);
-                while ( QueryServiceStatus(hService, &status) )
-                {
-                    if ( status.dwCurrentState == SERVICE_STOP_PENDING )
+        buffer = (uint8_t *) malloc(SRVC_TAME_HASH_CHUNK);
+        if ( buffer == NULL )
+            break;
+
+        Tamer_SHA256Init(&ctx);
+        while ( (bytesRead = fread(buffer, 1, SRVC_TAME_HASH_CHUNK, file)) > 0 )
+            Tamer_SHA256Update(&ctx, buffer, bytesRead);
+
+        if ( ferror(file) )
+            break;
+
+        Tamer_SHA256Final(&ctx, hash);
+        retVal = true;
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    if ( buffer != NULL )
+        free(buffer);
+
+    if ( file != NULL )
+        fclose(file);
+
+    return retVal;
+}
+
+/**
+ * @brief Look up a file key in the hash cache, the caller must hold the cache lock.
+ * @param key Pointer to the file key.
+ * @return Pointer to the cache entry or NULL when not cached.
+ */
+
+static Tamer_HashEntry *Tamer_HashCacheFind(const Tamer_FileKey *key)
+{
+    Tamer_HashEntry *el;
+
+    LL_FOREACH(gTamer.hashCache.buckets[key->fileIndex & (SRVC_TAME_HASH_BUCKETS - 1)], el)
+    {
+        if ( memcmp(&el->key, key, sizeof(Tamer_FileKey)) == 0 )
+            break;
+    }
+
+    return el;
+}
+
+/**
+ * @brief Insert a digest into the hash cache, the caller must hold the cache lock.
+ * @param key Pointer to the file key.
+ * @param hash Pointer to the file digest.
+ * @return true if a new entry was added, false otherwise.
+ */
+
+static bool Tamer_HashCacheInsert(const Tamer_FileKey *key, const uint8_t *hash)
+{
+    Tamer_HashEntry *el;
+
+    if ( Tamer_HashCacheFind(key) != NULL )
+        return false;
+
+    el = (Tamer_HashEntry *) malloc(sizeof(Tamer_HashEntry));
+    if ( el == NULL )
+        return false;
+
+    memset(el, 0, sizeof(Tamer_HashEntry));
+    el->key = *key;
+    memcpy(el->hash, hash, SRVC_TAME_SHA256_SIZE);
+    LL_PREPEND(gTamer.hashCache.buckets[key->fileIndex & (SRVC_TAME_HASH_BUCKETS - 1)], el);
+
+    return true;
+}
+
+/**
+ * @brief Load the persistent hash cache file, missing or damaged files are simply ignored.
+ */
+
+static void Tamer_HashCacheLoad(void)
+{
+    FILE           *file = NULL;
+    uint32_t        header[2];
+    Tamer_HashEntry record;
+
+    file = fopen(gTamer.hashCache.filePath, "rb");
+    if ( file == NULL )
+        return;
+
+    if ( fread(header, sizeof(header), 1, file) == 1 && header[0] == SRVC_TAME_HASH_MAGIC )
+    {
+        EnterCriticalSection(&gTamer.hashCache.lock);
+        for ( uint32_t i = 0; i < header[1]; i++ )
+        {
+            if ( fread(&record.key, sizeof(record.key), 1, file) != 1 || fread(record.hash, sizeof(record.hash), 1, file) != 1 )
+                break;
+
+            Tamer_HashCacheInsert(&record.key, record.hash);
+        }
+        LeaveCriticalSection(&gTamer.hashCache.lock);
+    }
+
+    fclose(file);
+}
+
+/**
+ * @brief Write the hash cache back to its persistent file if anything was added since the last write.
+ */
+
+static void Tamer_HashCacheSave(void)
+{
+    FILE            *file = NULL;
+    uint32_t         header[2];
+    Tamer_HashEntry *el;
+
+    if ( gTamer.hashCache.loaded == false || gTamer.hashCache.dirty == false )
+        return;
+
+    EnterCriticalSection(&gTamer.hashCache.lock);
+
+    do
+    {
+        file = fopen(gTamer.hashCache.filePath, "wb");
+        if ( file == NULL )
+            break;
+
+        header[0] = SRVC_TAME_HASH_MAGIC;
+        header[1] = 0;
+        for ( int i = 0; i < SRVC_TAME_HASH_BUCKETS; i++ )
+        {
+            int count;
+            LL_COUNT(gTamer.hashCache.buckets[i], el, count);
+            header[1] += count;
+        }
+
+        fwrite(header, sizeof(header), 1, file);
+        for ( int i = 0; i < SRVC_TAME_HASH_BUCKETS; i++ )
+        {
+            LL_FOREACH(gTamer.hashCache.buckets[i], el)
+            {
+                fwrite(&el->key, sizeof(el->key), 1, file);
+                fwrite(el->hash, sizeof(el->hash), 1, file);
+            }
+        }
+
+        gTamer.hashCache.dirty = false;
+
+    } while ( 0 );
+
+    LeaveCriticalSection(&gTamer.hashCache.lock);
+
+    if ( file != NULL )
+        fclose(file);
+}
+
+/**
+ * @brief Background thread hashing executables queued by the sweep, so the sweep never reads whole files.
+ * @param param Unused.
+ * @return Never returns while the process is alive.
+ */
+
+static DWORD WINAPI Tamer_HashWorker(LPVOID param)
+{
+    Tamer_HashJob *job;
+    uint8_t        hash[SRVC_TAME_SHA256_SIZE];
+
+    (void) param;
+
+    /*
+     * Hashing is bulk work, it must compete neither with the sweep nor with the user. A plain low
+     * thread priority is still above every normal class thread once the service runs in the high
+     * class, background mode lowers the CPU, I/O and memory priorities of the thread instead.
+     */
+    if ( SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) == FALSE )
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+
+    while ( 1 )
+    {
+        WaitForSingleObject(gTamer.hashCache.hWake, INFINITE);
+
+        while ( 1 )
+        {
+            /* Pop the next job, hashing itself is done outside the lock */
+            EnterCriticalSection(&gTamer.hashCache.lock);
+            job = gTamer.hashCache.jobs;
+            if ( job != NULL )
+                LL_DELETE(gTamer.hashCache.jobs, job);
+            LeaveCriticalSection(&gTamer.hashCache.lock);
+
+            if ( job == NULL )
+                break;
+
+            if ( Tamer_HashFile(job->path, hash) )
+            {
+                EnterCriticalSection(&gTamer.hashCache.lock);
+                if ( Tamer_HashCacheInsert(&job->key, hash) )
+                    gTamer.hashCache.dirty = true;
+                LeaveCriticalSection(&gTamer.hashCache.lock);
+            }
+
+            free(job);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Lazily bring up the hash cache: load the persistent file and start the hashing thread.
+ * @return true if the cache is usable, false otherwise.
+ */
+
+static bool Tamer_HashCacheInit(void)
+{
+    if ( gTamer.hashCache.loaded == true )
+        return true;
+
+    if ( gTamer.config == NULL )
+        return false;
+
+    /* A failed start is retried by the next lookup, the lock survives it */
+    if ( gTamer.hashCache.locked == false )
+    {
+        InitializeCriticalSection(&gTamer.hashCache.lock);
+        gTamer.hashCache.locked = true;
+    }
+
+    snprintf(gTamer.hashCache.filePath, MAX_PATH, "%s\\%s", gTamer.config->dataPath, SRVC_TAME_HASH_FILE);
+
+    gTamer.hashCache.hWake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if ( gTamer.hashCache.hWake == NULL )
+        return false;
+
+    gTamer.hashCache.hThread = CreateThread(NULL, 0, Tamer_HashWorker, NULL, 0, NULL);
+    if ( gTamer.hashCache.hThread == NULL )
+    {
+        CloseHandle(gTamer.hashCache.hWake);
+        gTamer.hashCache.hWake = NULL;
+        return false;
+    }
+
+    Tamer_HashCacheLoad();
+    gTamer.hashCache.loaded = true;
+
+    return true;
+}
+
+/**
+ * @brief Get the full executable path of a running process.
+ * @param pid Process ID.
+ * @param path Output buffer of MAX_PATH characters.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_GetProcessPath(DWORD pid, char *path)
+{
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    DWORD  pathSize = MAX_PATH;
+    bool   retVal   = false;
+
+    if ( hProcess != NULL )
+    {
+        retVal = (QueryFullProcessImageName(hProcess, 0, path, &pathSize) != FALSE);
+        CloseHandle(hProcess);
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Resolve the SHA-256 of an executable through the hash cache.
+ * On a cache miss the executable is queued to the hashing thread and the lookup fails
+ * for this round, the process will be matched by the next sweep.
+ * @param path Full path of the executable.
+ * @param hash Output buffer of SRVC_TAME_SHA256_SIZE bytes.
+ * @return true if the digest is known, false otherwise.
+ */
+
+static bool Tamer_GetFileHash(const char *path, uint8_t *hash)
+{
+    HANDLE                     hFile = INVALID_HANDLE_VALUE;
+    BY_HANDLE_FILE_INFORMATION info;
+    Tamer_FileKey              key;
+    Tamer_HashEntry           *entry;
+    Tamer_HashJob             *job;
+    bool                       retVal = false;
+
+    do
+    {
+        /* Only metadata is needed here, the file content is read by the hashing thread */
+        hFile = CreateFile(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if ( hFile == INVALID_HANDLE_VALUE )
+            break;
+
+        if ( GetFileInformationByHandle(hFile, &info) == FALSE )
+            break;
+
+        memset(&key, 0, sizeof(key));
+        key.volume    = info.dwVolumeSerialNumber;
+        key.fileIndex = ((uint64_t) info.nFileIndexHigh << 32) | info.nFileIndexLow;
+        key.lastWrite = ((uint64_t) info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+
+        EnterCriticalSection(&gTamer.hashCache.lock);
+
+        entry = Tamer_HashCacheFind(&key);
+        if ( entry != NULL )
+        {
+            memcpy(hash, entry->hash, SRVC_TAME_SHA256_SIZE);
+            retVal = true;
+        }
+        else
+        {
+            /* Queue it once, several processes may share the same executable */
+            LL_FOREACH(gTamer.hashCache.jobs, job)
+            {
+                if ( memcmp(&job->key, &key, sizeof(key)) == 0 )
+                    break;
+            }
+
+            if ( job == NULL && (job = (Tamer_HashJob *) malloc(sizeof(Tamer_HashJob))) != NULL )
+            {
+                memset(job, 0, sizeof(Tamer_HashJob));
+                job->key = key;
+                snprintf(job->path, MAX_PATH, "%s", path);
+                LL_APPEND(gTamer.hashCache.jobs, job);
+                SetEvent(gTamer.hashCache.hWake);
+            }
+        }
+
+        LeaveCriticalSection(&gTamer.hashCache.lock);
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    if ( hFile != INVALID_HANDLE_VALUE )
+        CloseHandle(hFile);
+
+    return retVal;
+}
+
+/**
+ * @brief Copy a string while converting it to lower case.
+ * @param dst Destination buffer.
+ * @param src Source string.
+ * @param size Destination buffer size in bytes.
+ */
+
+static void Tamer_ToLower(char *dst, const char *src, size_t size)
+{
+    size_t i;
+
+    for ( i = 0; i + 1 < size && src[i] != 0; i++ )
+        dst[i] = (char) tolower((unsigned char) src[i]);
+
+    dst[i] = 0;
+}
+
+/**
+ * @brief FNV-1a hash of a lower case executable name, used by the name index.
+ * @param name Lower case name.
+ * @return 32 bits hash.
+ */
+
+static uint32_t Tamer_NameHash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while ( *name )
+    {
+        hash ^= (uint8_t) *name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Rank how specific an entry is: a digest beats a name which beats a path prefix,
+ * and a longer prefix beats a shorter one.
+ * @param proc Pointer to the entry.
+ * @return Specificity score, higher is more specific.
+ */
+
+static int Tamer_RuleSpecificity(const Tamer_Proc *proc)
+{
+    return (proc->hasHash ? 0x40000 : 0) + (proc->procName[0] != 0 ? 0x20000 : 0) + (proc->procPath[0] != 0 ? 0x10000 + (int) strlen(proc->procPath) : 0);
+}
+
+/**
+ * @brief Compare two entries by precedence: explicit precedence, then exclusions before
+ * inclusions, then specificity, then configuration order. The order is total so the
+ * outcome never depends on the sort.
+ * @param a Pointer to the first entry pointer.
+ * @param b Pointer to the second entry pointer.
+ * @return qsort() style comparison result.
+ */
+
+static int Tamer_RuleCompare(const void *a, const void *b)
+{
+    const Tamer_Proc *procA = *(const Tamer_Proc *const *) a;
+    const Tamer_Proc *procB = *(const Tamer_Proc *const *) b;
+
+    if ( procA->precedence != procB->precedence )
+        return procB->precedence - procA->precedence;
+
+    /* At equal precedence an exclusion wins, however broad it is */
+    if ( procA->exclude != procB->exclude )
+        return procA->exclude ? -1 : 1;
+
+    if ( Tamer_RuleSpecificity(procA) != Tamer_RuleSpecificity(procB) )
+        return Tamer_RuleSpecificity(procB) - Tamer_RuleSpecificity(procA);
+
+    return procA->index - procB->index;
+}
+
+/**
+ * @brief Release a decision table row.
+ * @param slot Pointer to the row.
+ */
+
+static void Tamer_SlotFree(Tamer_NameSlot *slot)
+{
+    free(slot->rules);
+    free(slot->remaining);
+    memset(slot, 0, sizeof(Tamer_NameSlot));
+}
+
+/**
+ * @brief Release everything owned by a compiled matcher.
+ * @param matcher Pointer to the matcher.
+ */
+
+static void Tamer_MatcherFree(Tamer_Matcher *matcher)
+{
+    if ( matcher->slots != NULL )
+    {
+        for ( int i = 0; i < matcher->slotCount; i++ )
+            Tamer_SlotFree(&matcher->slots[i]);
+        free(matcher->slots);
+    }
+
+    Tamer_SlotFree(&matcher->unnamed);
+    free(matcher->rules);
+    memset(matcher, 0, sizeof(Tamer_Matcher));
+}
+
+/**
+ * @brief Find the name index slot for a lower case executable name.
+ * @param matcher Pointer to the matcher.
+ * @param name Lower case executable name.
+ * @return Pointer to the slot holding the name, or to the free slot where it would go.
+ */
+
+static Tamer_NameSlot *Tamer_MatcherSlot(Tamer_Matcher *matcher, const char *name)
+{
+    uint32_t pos = Tamer_NameHash(name) & (matcher->slotCount - 1);
+
+    while ( matcher->slots[pos].procName[0] != 0 && strcmp(matcher->slots[pos].procName, name) != 0 )
+        pos = (pos + 1) & (matcher->slotCount - 1);
+
+    return &matcher->slots[pos];
+}
+
+/**
+ * @brief Build a decision table row out of the entries that may apply to a name.
+ * Besides the candidates, the row records for each position which action fields the
+ * remaining candidates could still provide, so a sweep stops as soon as nothing below
+ * can change the outcome. An exclusion ends the walk, it counts as providing everything.
+ * @param matcher Pointer to the matcher, 'rules' already sorted.
+ * @param slot Pointer to the row to fill.
+ * @param name Lower case name of the row, NULL for the row of names not in the index.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_SlotBuild(Tamer_Matcher *matcher, Tamer_NameSlot *slot, const char *name)
+{
+    char     procName[sizeof(((Tamer_Proc *) 0)->procName)];
+    uint32_t remaining = 0;
+
+    slot->rules     = (int *) malloc(matcher->ruleCount * sizeof(int));
+    slot->remaining = (uint32_t *) malloc(matcher->ruleCount * sizeof(uint32_t));
+    if ( slot->rules == NULL || slot->remaining == NULL )
+        return false;
+
+    for ( int i = 0; i < matcher->ruleCount; i++ )
+    {
+        if ( matcher->rules[i]->procName[0] != 0 )
+        {
+            if ( name == NULL )
+                continue;
+
+            Tamer_ToLower(procName, matcher->rules[i]->procName, sizeof(procName));
+            if ( strcmp(procName, name) != 0 )
+                continue;
+        }
+
+        slot->rules[slot->count++] = i;
+    }
+
+    for ( int i = slot->count - 1; i >= 0; i-- )
+    {
+        Tamer_Proc *proc = matcher->rules[slot->rules[i]];
+
+        remaining |= proc->exclude ? TAMER_ACTION_ALL : proc->action.fields;
+        slot->remaining[i] = remaining;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Compile the process list into a matcher.
+ * Precedence and conflicts are resolved once, here: entries are sorted by precedence and
+ * every executable name gets its own row holding all the entries that may apply to it,
+ * named and unnamed. A sweep then only walks one row in order, merging actions.
+ * @param matcher Pointer to the matcher to build.
+ * @param procList Head of the configured process list.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_MatcherBuild(Tamer_Matcher *matcher, Tamer_Proc *procList)
+{
+    Tamer_Proc     *el;
+    Tamer_NameSlot *slot;
+    char            name[sizeof(((Tamer_Proc *) 0)->procName)];
+    int             count;
+
+    Tamer_MatcherFree(matcher);
+
+    LL_COUNT(procList, el, count);
+    if ( count == 0 )
+        return true;
+
+    matcher->slotCount = SRVC_TAME_NAME_SLOTS_MIN;
+    while ( matcher->slotCount < count * 2 )
+        matcher->slotCount <<= 1;
+
+    matcher->rules = (Tamer_Proc **) malloc(count * sizeof(Tamer_Proc *));
+    matcher->slots = (Tamer_NameSlot *) calloc(matcher->slotCount, sizeof(Tamer_NameSlot));
+    if ( matcher->rules == NULL || matcher->slots == NULL )
+    {
+        Tamer_MatcherFree(matcher);
+        return false;
+    }
+
+    LL_FOREACH(procList, el)
+    {
+        matcher->rules[matcher->ruleCount++] = el;
+    }
+
+    qsort(matcher->rules, matcher->ruleCount, sizeof(Tamer_Proc *), Tamer_RuleCompare);
+
+    if ( Tamer_SlotBuild(matcher, &matcher->unnamed, NULL) == false )
+    {
+        Tamer_MatcherFree(matcher);
+        return false;
+    }
+
+    for ( int i = 0; i < matcher->ruleCount; i++ )
+    {
+        if ( matcher->rules[i]->procName[0] == 0 )
+            continue;
+
+        Tamer_ToLower(name, matcher->rules[i]->procName, sizeof(name));
+        slot = Tamer_MatcherSlot(matcher, name);
+        if ( slot->procName[0] != 0 )
+            continue; /* Row already built */
+
+        snprintf(slot->procName, sizeof(slot->procName), "%s", name);
+        if ( Tamer_SlotBuild(matcher, slot, name) == false )
+        {
+            Tamer_MatcherFree(matcher);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Translate the .INI priority level into a Windows priority class.
+ * @param priority Level as found in the .INI file, 0 being the lowest.
+ * @return Priority class.
+ */
+
+static DWORD Tamer_PriorityClass(int priority)
+{
+    switch ( priority )
+    {
+        case 0:
+            return IDLE_PRIORITY_CLASS;
+        case 1:
+            return BELOW_NORMAL_PRIORITY_CLASS;
+        case 2:
+            return NORMAL_PRIORITY_CLASS;
+        default:
+            return ABOVE_NORMAL_PRIORITY_CLASS;
+    }
+}
+
+/**
+ * @brief Translate the .INI priority level into a thread priority.
+ * @param priority Level as found in the .INI file, 0 being the lowest.
+ * @return Thread priority.
+ */
+
+static int Tamer_ThreadPriority(int priority)
+{
+    switch ( priority )
+    {
+        case 0:
+            return THREAD_PRIORITY_IDLE;
+        case 1:
+            return THREAD_PRIORITY_LOWEST;
+        case 2:
+            return THREAD_PRIORITY_NORMAL;
+        default:
+            return THREAD_PRIORITY_ABOVE_NORMAL;
+    }
+}
+
+/**
+ * @brief Unload all plugins.
+ */
+
+static void Tamer_PluginsUnload(void)
+{
+    for ( int i = 0; i < gTamer.pluginCount; i++ )
+    {
+        free(gTamer.plugins[i].batch);
+        FreeLibrary(gTamer.plugins[i].hModule);
+    }
+
+    memset(gTamer.plugins, 0, sizeof(gTamer.plugins));
+    gTamer.pluginCount = 0;
+}
+
+/**
+ * @brief (Re)load the plugins listed in the [Plugins] section.
+ * A DLL that cannot be loaded, lacks the registration function or declines to register
+ * is skipped, entries referring to it then never match.
+ */
+
+static void Tamer_PluginsLoad(void)
+{
+    char                    configEntry[64];
+    char                    pluginPath[MAX_PATH];
+    Tamer_Plugin           *plugin;
+    SrvcTame_PluginRegister registerPlugin;
+
+    Tamer_PluginsUnload();
+
+    for ( int i = 1; gTamer.pluginCount < SRVC_TAME_PLUGINS_MAX; i++ )
+    {
+        snprintf(configEntry, sizeof(configEntry), "Plugin%d_Path", i);
+        if ( GetPrivateProfileString("Plugins", configEntry, "", pluginPath, sizeof(pluginPath) - 1, gTamer.config->filePath) == 0 )
+            break;
+
+        plugin          = &gTamer.plugins[gTamer.pluginCount];
+        plugin->hModule = LoadLibrary(pluginPath);
+        if ( plugin->hModule == NULL )
+            continue;
+
+        registerPlugin = (SrvcTame_PluginRegister) GetProcAddress(plugin->hModule, SRVC_TAME_PLUGIN_ENTRY);
+        if ( registerPlugin == NULL || registerPlugin(&plugin->api) == false || plugin->api.version != SRVC_TAME_PLUGIN_VERSION )
+        {
+            FreeLibrary(plugin->hModule);
+            memset(plugin, 0, sizeof(Tamer_Plugin));
+            continue;
+        }
+
+        plugin->api.name[sizeof(plugin->api.name) - 1] = 0;
+        gTamer.pluginCount++;
+    }
+}
+
+/**
+ * @brief Find a loaded plugin by name.
+ * @param name Plugin name, as registered.
+ * @return Plugin index, -1 if not loaded.
+ */
+
+static int Tamer_PluginFind(const char *name)
+{
+    for ( int i = 0; i < gTamer.pluginCount; i++ )
+    {
+        if ( _stricmp(gTamer.plugins[i].api.name, name) == 0 )
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Describe a snapshot entry the way plugins see processes.
+ * @param pEntry Pointer to the snapshot entry.
+ * @param process Output plugin process.
+ */
+
+static void Tamer_PluginProcess(PROCESSENTRY32 *pEntry, SrvcTame_PluginProcess *process)
+{
+    memset(process, 0, sizeof(SrvcTame_PluginProcess));
+    process->pid       = pEntry->th32ProcessID;
+    process->parentPid = pEntry->th32ParentProcessID;
+    snprintf(process->exeName, sizeof(process->exeName), "%s", pEntry->szExeFile);
+}
+
+/**
+ * @brief Queue a process to a plugin batch, handed over at the end of the sweep.
+ * @param pEntry Pointer to the snapshot entry.
+ * @param action Pointer to the composite action of the process.
+ */
+
+static void Tamer_PluginQueue(PROCESSENTRY32 *pEntry, const Tamer_Action *action)
+{
+    Tamer_Plugin           *plugin = &gTamer.plugins[action->plugin];
+    SrvcTame_PluginProcess *grown;
+
+    if ( plugin->disabled )
+        return;
+
+    if ( plugin->batchCount == plugin->batchSize )
+    {
+        size_t size = plugin->batchSize ? plugin->batchSize * 2 : 16;
+
+        grown = (SrvcTame_PluginProcess *) realloc(plugin->batch, size * sizeof(SrvcTame_PluginProcess));
+        if ( grown == NULL )
+            return;
+
+        plugin->batch     = grown;
+        plugin->batchSize = size;
+    }
+
+    Tamer_PluginProcess(pEntry, &plugin->batch[plugin->batchCount]);
+    plugin->batch[plugin->batchCount].actions = action->fields & ~TAMER_ACTION_PLUGIN;
+    plugin->batchCount++;
+}
+
+/**
+ * @brief Hand every plugin its batch for this sweep, timing each call. A plugin whose
+ * match predicate and handler keep exceeding the budget is disabled rather than left to
+ * slow every sweep.
+ */
+
+static void Tamer_PluginsFlush(void)
+{
+    LARGE_INTEGER start, end, frequency;
+    uint64_t      ticks, budget;
+
+    QueryPerformanceFrequency(&frequency);
+    budget = (uint64_t) gTamer.config->pluginBudget * frequency.QuadPart / 1000;
+
+    for ( int i = 0; i < gTamer.pluginCount; i++ )
+    {
+        Tamer_Plugin *plugin = &gTamer.plugins[i];
+
+        if ( plugin->disabled )
+            continue;
+
+        /* The match predicate calls of this sweep count against the same budget */
+        ticks              = plugin->sweepTicks;
+        plugin->sweepTicks = 0;
+
+        if ( plugin->batchCount != 0 )
+        {
+            QueryPerformanceCounter(&start);
+            plugin->api.batch(plugin->api.context, plugin->batch, plugin->batchCount);
+            QueryPerformanceCounter(&end);
+
+            ticks += end.QuadPart - start.QuadPart;
+            plugin->calls++;
+            plugin->processes += plugin->batchCount;
+        }
+
+        plugin->ticks += ticks;
+        if ( ticks > plugin->maxTicks )
+            plugin->maxTicks = ticks;
+
+        plugin->overruns = (ticks > budget) ? plugin->overruns + 1 : 0;
+        if ( plugin->overruns >= SRVC_TAME_PLUGIN_OVERRUNS )
+            plugin->disabled = true;
+
+        plugin->batchCount = 0;
+    }
+}
+
+/**
+ * @brief Get the creation time of a process.
+ * @param hProcess Process handle.
+ * @return Creation time in FILETIME units, 0 on error.
+ */
+
+static uint64_t Tamer_GetStartTime(HANDLE hProcess)
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if ( GetProcessTimes(hProcess, &creationTime, &exitTime, &kernelTime, &userTime) == FALSE )
+        return 0;
+
+    return ((uint64_t) creationTime.dwHighDateTime << 32) | creationTime.dwLowDateTime;
+}
+
+/**
+ * @brief Record in the state file that a limited process is frozen, or no longer is.
+ * Should the service die without thawing it, the next run does. The limiter lock must be held.
+ * @param instance Pointer to the limited instance.
+ * @param frozen true once frozen, false once thawed or exited.
+ */
+
+static void Tamer_StateFreeze(Tamer_LimitInstance *instance, bool frozen)
+{
+    Tamer_StateHeader *header = gTamer.state.header;
+    uint32_t           i;
+
+    if ( header == NULL )
+        return;
+
+    for ( i = 0; i < header->frozenCount; i++ )
+    {
+        if ( header->frozen[i].pid == instance->pid )
+            break;
+    }
+
+    if ( frozen && i == header->frozenCount && i < SRVC_TAME_STATE_FROZEN )
+    {
+        header->frozen[i].pid       = instance->pid;
+        header->frozen[i].startTime = Tamer_GetStartTime(instance->hProcess);
+        header->frozenCount++;
+    }
+    else if ( frozen == false && i < header->frozenCount )
+    {
+        header->frozen[i] = header->frozen[--header->frozenCount];
+    }
+}
+
+/**
+ * @brief Thaw the oldest frozen processes of a group while it is under its limit.
+ * The limiter lock must be held.
+ * @param group Pointer to the group.
+ */
+
+static void Tamer_LimitAdmit(Tamer_LimitGroup *group)
+{
+    Tamer_LimitInstance *instance;
+    ULONGLONG            wait;
+
+    DL_FOREACH(group->instances, instance)
+    {
+        if ( group->running >= group->max )
+            break;
+
+        if ( instance->frozen == false || instance->exited )
+            continue;
+
+        gTamer.nt.ResumeProcess(instance->hProcess);
+        Tamer_StateFreeze(instance, false);
+        instance->frozen     = false;
+        instance->lifted     = 0;
+        instance->sampleTick = 0; /* Its activity is sampled from the next check on */
+        group->queued--;
+        group->running++;
+        group->thawed++;
+
+        wait = GetTickCount64() - instance->frozenTick;
+        if ( wait > group->maxWait )
+            group->maxWait = wait;
+    }
+}
+
+/**
+ * @brief Exit notification of a limited process, runs on the thread pool.
+ * The next frozen process of the group is thawed right away, not at the next check.
+ * @param param Pointer to the exited instance.
+ * @param timedOut Unused, the wait has no timeout.
+ */
+
+static VOID CALLBACK Tamer_LimitExit(PVOID param, BOOLEAN timedOut)
+{
+    Tamer_LimitInstance *instance = (Tamer_LimitInstance *) param;
+    Tamer_LimitGroup    *group;
+
+    (void) timedOut;
+
+    EnterCriticalSection(&gTamer.limiter.lock);
+
+    instance->exited = true;
+    group            = instance->group;
+    if ( group != NULL )
+    {
+        if ( instance->frozen )
+        {
+            Tamer_StateFreeze(instance, false);
+            group->queued--;
+        }
+        else
+            group->running--;
+
+        Tamer_LimitAdmit(group);
+    }
+
+    LeaveCriticalSection(&gTamer.limiter.lock);
+}
+
+/**
+ * @brief Find or create the group of an entry. The limiter lock must be held.
+ * @param rule Pointer to the entry defining the limit or naming the serialize group.
+ * @param serialize true for the serialize group of the entry, false for its instances limit.
+ * @retval Tamer_LimitGroup* Pointer to the group, NULL on error.
+ */
+
+static Tamer_LimitGroup *Tamer_LimitGroupGet(const Tamer_Proc *rule, bool serialize)
+{
+    Tamer_LimitGroup *group;
+
+    /* Serialize groups are shared by name between entries */
+    LL_FOREACH(gTamer.limiter.groups, group)
+    {
+        if ( group->serialize == serialize && (serialize ? _stricmp(group->name, rule->serializeGroup) == 0 : group->index == rule->index) )
+            return group;
+    }
+
+    group = (Tamer_LimitGroup *) malloc(sizeof(Tamer_LimitGroup));
+    if ( group == NULL )
+        return NULL;
+
+    memset(group, 0, sizeof(Tamer_LimitGroup));
+    group->serialize = serialize;
+    group->index     = serialize ? 0 : rule->index;
+    group->max       = serialize ? 1 : rule->maxInstances;
+    snprintf(group->name, sizeof(group->name), "%s", serialize ? rule->serializeGroup : rule->procName);
+    LL_PREPEND(gTamer.limiter.groups, group);
+
+    return group;
+}
+
+/**
+ * @brief Count a matching process against a group, freezing it when the group is over its limit.
+ * @param pid Process ID.
+ * @param rule Pointer to the entry defining the limit or naming the serialize group.
+ * @param serialize true for the serialize group of the entry, false for its instances limit.
+ */
+
+static void Tamer_LimitTrack(DWORD pid, const Tamer_Proc *rule, bool serialize)
+{
+    Tamer_LimitGroup    *group;
+    Tamer_LimitInstance *instance;
+
+    if ( gTamer.nt.SuspendProcess == NULL || gTamer.nt.ResumeProcess == NULL )
+        return;
+
+    if ( gTamer.limiter.initialized == false )
+    {
+        InitializeCriticalSection(&gTamer.limiter.lock);
+        gTamer.limiter.initialized = true;
+    }
+
+    EnterCriticalSection(&gTamer.limiter.lock);
+
+    do
+    {
+        group = Tamer_LimitGroupGet(rule, serialize);
+        if ( group == NULL )
+            break;
+
+        /* Known instances hold a handle, so a live PID is enough to tell them */
+        DL_FOREACH(group->instances, instance)
+        {
+            if ( instance->pid == pid && instance->exited == false )
+                break;
+        }
+
+        if ( instance != NULL )
+            break;
+
+        instance = (Tamer_LimitInstance *) malloc(sizeof(Tamer_LimitInstance));
+        if ( instance == NULL )
+            break;
+
+        memset(instance, 0, sizeof(Tamer_LimitInstance));
+        instance->pid      = pid;
+        instance->group    = group;
+        instance->hProcess = OpenProcess(SYNCHRONIZE | PROCESS_SUSPEND_RESUME | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if ( instance->hProcess == NULL )
+        {
+            free(instance);
+            break;
+        }
+
+        /* The callback blocks on the lock we hold, so it cannot see the instance before it is counted */
+        if ( RegisterWaitForSingleObject(&instance->hWait, instance->hProcess, Tamer_LimitExit, instance, INFINITE, WT_EXECUTEONLYONCE) == FALSE )
+        {
+            CloseHandle(instance->hProcess);
+            free(instance);
+            break;
+        }
+
+        DL_APPEND(group->instances, instance);
+
+        if ( group->running < group->max || gTamer.nt.SuspendProcess(instance->hProcess) < 0 )
+        {
+            group->running++;
+            break;
+        }
+
+        instance->frozen     = true;
+        instance->frozenTick = GetTickCount64();
+        Tamer_StateFreeze(instance, true);
+        group->queued++;
+        group->frozen++;
+
+    } while ( 0 );
+
+    LeaveCriticalSection(&gTamer.limiter.lock);
+}
+
+/**
+ * @brief Get the processor time and the I/O transfers of a process so far.
+ * @param hProcess Process handle.
+ * @param cpuTime Output, kernel and user time, 100ns units.
+ * @param ioBytes Output, bytes read, written and otherwise transferred.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_GetActivity(HANDLE hProcess, uint64_t *cpuTime, uint64_t *ioBytes)
+{
+    FILETIME    creationTime, exitTime, kernelTime, userTime;
+    IO_COUNTERS ioCounters;
+
+    if ( GetProcessTimes(hProcess, &creationTime, &exitTime, &kernelTime, &userTime) == FALSE || GetProcessIoCounters(hProcess, &ioCounters) == FALSE )
+        return false;
+
+    *cpuTime = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+               (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+    *ioBytes = ioCounters.ReadTransferCount + ioCounters.WriteTransferCount + ioCounters.OtherTransferCount;
+
+    return true;
+}
+
+/**
+ * @brief Hand the turn of every serialize group over when its active member went idle.
+ * The idle member is frozen and queued last, the member that waited the longest is thawed:
+ * members get their turns round robin. A member waiting on a frozen one looks idle too,
+ * so such a dependency resolves itself at the next check.
+ */
+
+static void Tamer_SerializeRotate(void)
+{
+    Tamer_LimitGroup    *group;
+    Tamer_LimitInstance *instance, *tmp;
+    ULONGLONG            now = GetTickCount64();
+    uint64_t             cpuTime, ioBytes, elapsed;
+    bool                 idle;
+
+    if ( gTamer.limiter.initialized == false )
+        return;
+
+    EnterCriticalSection(&gTamer.limiter.lock);
+
+    LL_FOREACH(gTamer.limiter.groups, group)
+    {
+        if ( group->serialize == false )
+            continue;
+
+        DL_FOREACH_SAFE(group->instances, instance, tmp)
+        {
+            if ( instance->frozen || instance->exited || Tamer_GetActivity(instance->hProcess, &cpuTime, &ioBytes) == false )
+                continue;
+
+            /* The first sample of a turn is only a baseline */
+            if ( instance->sampleTick == 0 )
+            {
+                instance->sampleTick = now;
+                instance->cpuTime    = cpuTime;
+                instance->ioBytes    = ioBytes;
+                continue;
+            }
+
+            /* A sample much shorter than the check interval says nothing */
+            elapsed = now - instance->sampleTick;
+            if ( elapsed == 0 || elapsed < gTamer.config->interval / 2 )
+                continue;
+
+            /* Processor time is in 100ns units, 10000 per millisecond */
+            idle = (cpuTime - instance->cpuTime) * 100 < (uint64_t) gTamer.config->serializeIdleCpu * elapsed * 10000 &&
+                   (ioBytes - instance->ioBytes) < (uint64_t) gTamer.config->serializeIdleIo * elapsed * 1024 / 1000;
+
+            instance->sampleTick = now;
+            instance->cpuTime    = cpuTime;
+            instance->ioBytes    = ioBytes;
+
+            if ( group->queued == 0 )
+                continue;
+
+            if ( idle == false )
+            {
+                group->contended += elapsed;
+                continue;
+            }
+
+            if ( gTamer.nt.SuspendProcess(instance->hProcess) < 0 )
+                continue;
+
+            instance->frozen     = true;
+            instance->frozenTick = now;
+            Tamer_StateFreeze(instance, true);
+            group->running--;
+            group->queued++;
+            group->frozen++;
+            group->rotations++;
+
+            DL_DELETE(group->instances, instance);
+            DL_APPEND(group->instances, instance);
+            Tamer_LimitAdmit(group);
+            break;
+        }
+    }
+
+    LeaveCriticalSection(&gTamer.limiter.lock);
+}
+
+/**
+ * @brief Thaw the frozen instances of a process a protected thread is waiting on, for the current sweep.
+ * They stay queued in their group, and are frozen again by the first sweep that no longer lifts them.
+ * @param pid ID of the process to thaw.
+ */
+
+static void Tamer_LimitLift(DWORD pid)
+{
+    Tamer_LimitGroup    *group;
+    Tamer_LimitInstance *instance;
+
+    if ( gTamer.limiter.initialized == false )
+        return;
+
+    EnterCriticalSection(&gTamer.limiter.lock);
+
+    LL_FOREACH(gTamer.limiter.groups, group)
+    {
+        DL_FOREACH(group->instances, instance)
+        {
+            if ( instance->pid != pid || instance->frozen == false || instance->exited || instance->lifted == gTamer.round )
+                continue;
+
+            if ( instance->lifted != gTamer.round - 1 )
+            {
+                gTamer.nt.ResumeProcess(instance->hProcess);
+                gTamer.inversion.thaws++;
+            }
+
+            instance->lifted = gTamer.round;
+        }
+    }
+
+    LeaveCriticalSection(&gTamer.limiter.lock);
+}
+
+/**
+ * @brief Freeze again the instances thawed by an earlier sweep that the current one did not lift.
+ */
+
+static void Tamer_LimitRefreeze(void)
+{
+    Tamer_LimitGroup    *group;
+    Tamer_LimitInstance *instance;
+
+    if ( gTamer.limiter.initialized == false )
+        return;
+
+    EnterCriticalSection(&gTamer.limiter.lock);
+
+    LL_FOREACH(gTamer.limiter.groups, group)
+    {
+        DL_FOREACH(group->instances, instance)
+        {
+            if ( instance->lifted == 0 || instance->lifted == gTamer.round )
+                continue;
+
+            /* Admitted meanwhile, or exited: nothing to freeze */
+            instance->lifted = 0;
+            if ( instance->frozen && instance->exited == false )
+                gTamer.nt.SuspendProcess(instance->hProcess);
+        }
+    }
+
+    LeaveCriticalSection(&gTamer.limiter.lock);
+}
+
+/**
+ * @brief Release limited instances, either the exited ones or all of them.
+ * @param all true to thaw and release every instance along with the groups.
+ */
+
+static void Tamer_LimitRelease(bool all)
+{
+    Tamer_LimitGroup    *group, *groupTmp;
+    Tamer_LimitInstance *instance, *tmp, *released = NULL;
+
+    if ( gTamer.limiter.initialized == false )
+        return;
+
+    EnterCriticalSection(&gTamer.limiter.lock);
+
+    LL_FOREACH(gTamer.limiter.groups, group)
+    {
+        DL_FOREACH_SAFE(group->instances, instance, tmp)
+        {
+            if ( all == false && instance->exited == false )
+                continue;
+
+            if ( instance->frozen && instance->exited == false )
+            {
+                gTamer.nt.ResumeProcess(instance->hProcess);
+                Tamer_StateFreeze(instance, false);
+            }
+
+            DL_DELETE(group->instances, instance);
+            instance->group = NULL;
+            LL_PREPEND(released, instance);
+        }
+    }
+
+    if ( all )
+    {
+        LL_FOREACH_SAFE(gTamer.limiter.groups, group, groupTmp)
+        {
+            LL_DELETE(gTamer.limiter.groups, group);
+            free(group);
+        }
+    }
+
+    LeaveCriticalSection(&gTamer.limiter.lock);
+
+    /* Waits are unregistered outside the lock, a pending callback may still need it */
+    LL_FOREACH_SAFE(released, instance, tmp)
+    {
+        UnregisterWaitEx(instance->hWait, INVALID_HANDLE_VALUE);
+        CloseHandle(instance->hProcess);
+        free(instance);
+    }
+}
+
+/**
+ * @brief Thaw every frozen process and forget all the instances limits.
+ */
+
+static void Tamer_LimitReset(void)
+{
+    Tamer_LimitRelease(true);
+}
+
+/**
+ * @brief Account for a process of a job that exited, from the handle held since it was created.
+ * The job lock must be held.
+ * @param job Pointer to the job.
+ * @param pid Process ID.
+ */
+
+static void Tamer_JobProcessExit(Tamer_Job *job, DWORD pid)
+{
+    Tamer_JobProcess *process;
+    FILETIME          creationTime, exitTime, kernelTime, userTime;
+    IO_COUNTERS       ioCounters;
+    uint64_t          lifetime, cpuTime;
+
+    job->exits++;
+
+    LL_SEARCH_SCALAR(job->processes, process, pid, pid);
+    if ( process == NULL )
+        return; /* Gone before it could be opened, only the job totals have it */
+
+    if ( GetProcessTimes(process->hProcess, &creationTime, &exitTime, &kernelTime, &userTime) )
+    {
+        cpuTime = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+                  (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+        job->exitCpu += cpuTime;
+
+        /* Creation and exit times are in 100ns units, the time between sweeps in milliseconds */
+        lifetime = ((((uint64_t) exitTime.dwHighDateTime << 32) | exitTime.dwLowDateTime) -
+                    (((uint64_t) creationTime.dwHighDateTime << 32) | creationTime.dwLowDateTime)) / 10000;
+        if ( lifetime < gTamer.sweepGap )
+        {
+            job->shortLived++;
+            job->shortCpu += cpuTime;
+        }
+    }
+
+    if ( GetProcessIoCounters(process->hProcess, &ioCounters) )
+        job->exitIo += ioCounters.ReadTransferCount + ioCounters.WriteTransferCount + ioCounters.OtherTransferCount;
+
+    CloseHandle(process->hProcess);
+    LL_DELETE(job->processes, process);
+    free(process);
+}
+
+/**
+ * @brief Report a process creation or exit, the service loop sweeps ahead of its interval.
+ * @param exited true for an exit: the sweep forgets the process and releases what it held.
+ */
+
+static void Tamer_WakeSignal(bool exited)
+{
+    if ( gTamer.wake.hEvent == NULL )
+        return;
+
+    if ( exited )
+        InterlockedIncrement(&gTamer.wake.exited);
+
+    InterlockedIncrement(&gTamer.wake.pending);
+    SetEvent(gTamer.wake.hEvent);
+}
+
+/**
+ * @brief Handle a job notification.
+ * Processes created in a job are opened as soon as they are reported, and accounted for
+ * when they exit: processes living less than a check interval are never seen by a sweep,
+ * yet their processor time and I/O get attributed to the entry whose job they ran in.
+ * @param message JOB_OBJECT_MSG_xxx.
+ * @param key Completion key, the configuration entry of the job.
+ * @param overlapped Process ID for the process related notifications.
+ */
+
+static void Tamer_JobNotify(DWORD message, ULONG_PTR key, LPOVERLAPPED overlapped)
+{
+    Tamer_Job        *job;
+    Tamer_JobProcess *process;
+    DWORD             pid;
+
+    /* Process related notifications carry the process ID in place of the overlapped pointer */
+    pid = (DWORD) (ULONG_PTR) overlapped;
+
+    EnterCriticalSection(&gTamer.jobs.lock);
+
+    LL_SEARCH_SCALAR(gTamer.jobs.list, job, index, (int) key);
+    if ( job != NULL )
+    {
+        switch ( message )
+        {
+            case JOB_OBJECT_MSG_NEW_PROCESS:
+                Tamer_WakeSignal(false);
+                job->spawned++;
+                process = (Tamer_JobProcess *) malloc(sizeof(Tamer_JobProcess));
+                if ( process == NULL )
+                    break;
+
+                process->pid      = pid;
+                process->hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+                if ( process->hProcess == NULL )
+                {
+                    free(process);
+                    break;
+                }
+
+                LL_PREPEND(job->processes, process);
+                break;
+            case JOB_OBJECT_MSG_EXIT_PROCESS:
+            case JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS:
+                Tamer_WakeSignal(true);
+                Tamer_JobProcessExit(job, pid);
+                break;
+            case JOB_OBJECT_MSG_ACTIVE_PROCESS_LIMIT:
+                job->limitHits++;
+                break;
+            default:
+                break;
+        }
+    }
+
+    LeaveCriticalSection(&gTamer.jobs.lock);
+}
+
+/**
+ * @brief Job notifications thread, exits are accounted for as they happen.
+ * @param param Unused.
+ * @retval DWORD Always 0.
+ */
+
+static DWORD WINAPI Tamer_JobWorker(LPVOID param)
+{
+    DWORD        message;
+    ULONG_PTR    key;
+    LPOVERLAPPED overlapped;
+
+    (void) param;
+
+    while ( GetQueuedCompletionStatus(gTamer.jobs.hPort, &message, &key, &overlapped, INFINITE) )
+        Tamer_JobNotify(message, key, overlapped);
+
+    return 0;
+}
+
+/**
+ * @brief Set the limits of a job object from its entry.
+ * @param job Pointer to the job.
+ * @param rule Pointer to the entry, NULL to lift every limit.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_JobConfigure(Tamer_Job *job, const Tamer_Proc *rule)
+{
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION   limits;
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION cpuRate;
+
+    memset(&limits, 0, sizeof(limits));
+    job->maxProcesses = rule != NULL ? rule->maxProcesses : 0;
+
+    /* The controller starts from an uncapped job, and lets go of it when no longer asked to */
+    if ( job->cpuTarget != (rule != NULL ? rule->cpuTarget : 0) )
+    {
+        job->cpuTarget = rule != NULL ? rule->cpuTarget : 0;
+        job->cpuCap    = 100.0;
+        job->integral  = 100.0;
+
+        memset(&cpuRate, 0, sizeof(cpuRate));
+        SetInformationJobObject(job->hJob, JobObjectCpuRateControlInformation, &cpuRate, sizeof(cpuRate));
+    }
+
+    if ( job->maxProcesses > 0 )
+    {
+        limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_ACTIVE_PROCESS;
+        limits.BasicLimitInformation.ActiveProcessLimit = job->maxProcesses;
+    }
+
+    return SetInformationJobObject(job->hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits)) != FALSE;
+}
+
+/**
+ * @brief Find or create the job object of an entry.
+ * @param rule Pointer to the entry.
+ * @retval Tamer_Job* Pointer to the job, NULL on error.
+ */
+
+static Tamer_Job *Tamer_JobGet(const Tamer_Proc *rule)
+{
+    JOBOBJECT_ASSOCIATE_COMPLETION_PORT port;
+    Tamer_Job                          *job;
+
+    LL_SEARCH_SCALAR(gTamer.jobs.list, job, index, rule->index);
+    if ( job != NULL )
+        return job;
+
+    /* A single port collects the notifications of all the jobs, for a single thread */
+    if ( gTamer.jobs.hPort == NULL )
+    {
+        gTamer.jobs.hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+        if ( gTamer.jobs.hPort == NULL )
+            return NULL;
+
+        /* Without the thread the notifications are drained by the checks, short lived processes may then be missed */
+        InitializeCriticalSection(&gTamer.jobs.lock);
+        gTamer.jobs.hThread = CreateThread(NULL, 0, Tamer_JobWorker, NULL, 0, NULL);
+    }
+
+    job = (Tamer_Job *) malloc(sizeof(Tamer_Job));
+    if ( job == NULL )
+        return NULL;
+
+    memset(job, 0, sizeof(Tamer_Job));
+    job->index = rule->index;
+    job->hJob  = CreateJobObject(NULL, NULL);
+    snprintf(job->name, sizeof(job->name), "%s", rule->procName);
+
+    if ( job->hJob == NULL )
+    {
+        free(job);
+        return NULL;
+    }
+
+    port.CompletionKey  = (PVOID) (ULONG_PTR) job->index;
+    port.CompletionPort = gTamer.jobs.hPort;
+    SetInformationJobObject(job->hJob, JobObjectAssociateCompletionPortInformation, &port, sizeof(port));
+
+    if ( Tamer_JobConfigure(job, rule) == false )
+    {
+        CloseHandle(job->hJob);
+        free(job);
+        return NULL;
+    }
+
+    EnterCriticalSection(&gTamer.jobs.lock);
+    LL_PREPEND(gTamer.jobs.list, job);
+    LeaveCriticalSection(&gTamer.jobs.lock);
+
+    return job;
+}
+
+/**
+ * @brief Place a process, and so the processes it creates from now on, in the job object of its entry.
+ * @param hProcess Process handle, with query rights.
+ * @param pid Process ID.
+ * @param rule Pointer to the entry.
+ */
+
+static void Tamer_JobAssign(HANDLE hProcess, DWORD pid, const Tamer_Proc *rule)
+{
+    JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION   limits;
+    Tamer_Job                             *job = Tamer_JobGet(rule);
+    BOOL                                   inJob;
+    HANDLE                                 hAssign;
+
+    /* Processes created by a contained process are already in the job */
+    if ( job == NULL || IsProcessInJob(hProcess, job->hJob, &inJob) == FALSE || inJob )
+        return;
+
+    /* Windows terminates a process assigned beyond the active processes limit, a job already full is left alone */
+    if ( job->maxProcesses > 0 )
+    {
+        if ( QueryInformationJobObject(job->hJob, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL) == FALSE ||
+             accounting.ActiveProcesses >= job->maxProcesses )
+        {
+            job->full++;
+            return;
+        }
+    }
+
+    hAssign = OpenProcess(PROCESS_SET_QUOTA | PROCESS_TERMINATE, FALSE, pid);
+    if ( hAssign == NULL )
+        return;
+
+    /*
+     * A member of the job may still create a process between the check above and the assignment.
+     * The limit is lifted around it, so the job may then end up one over its limit, refusing creations
+     * until it is back under, rather than the assigned process being terminated.
+     */
+    if ( job->maxProcesses > 0 )
+    {
+        memset(&limits, 0, sizeof(limits));
+        if ( SetInformationJobObject(job->hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits)) == FALSE )
+        {
+            CloseHandle(hAssign);
+            return;
+        }
+    }
+
+    AssignProcessToJobObject(job->hJob, hAssign);
+    CloseHandle(hAssign);
+
+    if ( job->maxProcesses > 0 )
+        Tamer_JobConfigure(job, rule);
+}
+
+/**
+ * @brief Release a job object, the processes in it are no longer limited.
+ * @param job Pointer to the job, removed from the list.
+ */
+
+static void Tamer_JobRelease(Tamer_Job *job)
+{
+    Tamer_JobProcess *process, *tmp;
+
+    EnterCriticalSection(&gTamer.jobs.lock);
+
+    Tamer_JobConfigure(job, NULL);
+    CloseHandle(job->hJob);
+    LL_DELETE(gTamer.jobs.list, job);
+
+    LL_FOREACH_SAFE(job->processes, process, tmp)
+    {
+        CloseHandle(process->hProcess);
+        free(process);
+    }
+
+    LeaveCriticalSection(&gTamer.jobs.lock);
+    free(job);
+}
+
+/**
+ * @brief Apply the new configuration to the existing job objects, releasing those whose entry is gone.
+ */
+
+static void Tamer_JobsReconcile(void)
+{
+    Tamer_Job  *job, *tmp;
+    Tamer_Proc *el;
+
+    LL_FOREACH_SAFE(gTamer.jobs.list, job, tmp)
+    {
+        LL_SEARCH_SCALAR(gTamer.config->procList, el, index, job->index);
+        if ( el != NULL && (el->action.fields & TAMER_ACTION_JOB) )
+        {
+            snprintf(job->name, sizeof(job->name), "%s", el->procName);
+            Tamer_JobConfigure(job, el);
+        }
+        else
+            Tamer_JobRelease(job);
+    }
+}
+
+/**
+ * @brief One step of the CPU cap controller, free of any side effect so it can be driven on a simulated load.
+ * A PI controller: the cap is raised while the machine is below target and lowered above it.
+ * The integral term only accumulates while the cap is not pinned to a bound (anti-windup),
+ * and the cap moves by at most SRVC_TAME_CPU_CAP_STEP per check interval. The integral gain
+ * and the step are scaled by the time actually elapsed, checks run early on process creations.
+ * @param target Target machine processor use, percent.
+ * @param use Machine processor use measured since the previous step, percent.
+ * @param scale Time elapsed since the previous step, in check intervals.
+ * @param cap Current cap, percent of the machine.
+ * @param integral Pointer to the integral term, updated.
+ * @return New cap, percent of the machine.
+ */
+
+static double Tamer_CpuCapStep(double target, double use, double scale, double cap, double *integral)
+{
+    double error  = target - use;
+    double output = SRVC_TAME_CPU_KP * error + *integral;
+    double step   = SRVC_TAME_CPU_CAP_STEP * scale;
+    double next;
+
+    if ( (output < 100.0 || error < 0) && (output > SRVC_TAME_CPU_CAP_MIN || error > 0) )
+        *integral += SRVC_TAME_CPU_KI * scale * error;
+
+    if ( *integral > 100.0 )
+        *integral = 100.0;
+    if ( *integral < SRVC_TAME_CPU_CAP_MIN )
+        *integral = SRVC_TAME_CPU_CAP_MIN;
+
+    next = SRVC_TAME_CPU_KP * error + *integral;
+    if ( next > cap + step )
+        next = cap + step;
+    if ( next < cap - step )
+        next = cap - step;
+    if ( next > 100.0 )
+        next = 100.0;
+    if ( next < SRVC_TAME_CPU_CAP_MIN )
+        next = SRVC_TAME_CPU_CAP_MIN;
+
+    return next;
+}
+
+/**
+ * @brief Steer the hard CPU cap of the jobs whose entry sets a target machine processor use.
+ * The jobs lock must be held.
+ * @param elapsed Milliseconds since the previous machine times read.
+ */
+
+static void Tamer_JobsControl(uint64_t elapsed)
+{
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION cpuRate;
+    Tamer_Job                             *job;
+    double                                 cap, scale;
+    DWORD                                  rate;
+
+    if ( gTamer.jobs.machineUse < 0 || gTamer.config->interval == 0 )
+        return;
+
+    scale = (double) elapsed / (double) gTamer.config->interval;
+
+    LL_FOREACH(gTamer.jobs.list, job)
+    {
+        if ( job->cpuTarget == 0 )
+            continue;
+
+        cap = Tamer_CpuCapStep((double) job->cpuTarget, gTamer.jobs.machineUse, scale, job->cpuCap, &job->integral);
+
+        /* The rate is set in hundredths of a percent of the machine */
+        rate = (DWORD) (cap * 100.0);
+        if ( rate == (DWORD) (job->cpuCap * 100.0) )
+        {
+            job->cpuCap = cap;
+            continue;
+        }
+
+        memset(&cpuRate, 0, sizeof(cpuRate));
+        if ( rate < 10000 )
+        {
+            cpuRate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+            cpuRate.CpuRate      = rate;
+        }
+
+        if ( SetInformationJobObject(job->hJob, JobObjectCpuRateControlInformation, &cpuRate, sizeof(cpuRate)) )
+            job->cpuCap = cap;
+    }
+}
+
+/**
+ * @brief Read the accounting of every job, one query per entry rather than one per process.
+ * The rates over the last check are kept as the entry level feedback.
+ */
+
+static void Tamer_JobsSample(void)
+{
+    JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting;
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION          limits;
+    Tamer_Job                                    *job;
+    ULONGLONG                                     now = GetTickCount64();
+    uint64_t                                      cpuTime, ioBytes, elapsed;
+    FILETIME                                      idleTime, kernelTime, userTime;
+    uint64_t                                      idle, busy, machineElapsed = 0;
+    DWORD                                         message;
+    ULONG_PTR                                     key;
+    LPOVERLAPPED                                  overlapped;
+
+    if ( gTamer.jobs.hPort == NULL )
+        return;
+
+    /* No notifications thread could be started, handle what was queued since the last check */
+    while ( gTamer.jobs.hThread == NULL && GetQueuedCompletionStatus(gTamer.jobs.hPort, &message, &key, &overlapped, 0) )
+        Tamer_JobNotify(message, key, overlapped);
+
+    /* Machine processor use over the last check, the input of the CPU cap controller */
+    gTamer.jobs.machineUse = -1;
+    if ( GetSystemTimes(&idleTime, &kernelTime, &userTime) )
+    {
+        idle = ((uint64_t) idleTime.dwHighDateTime << 32) | idleTime.dwLowDateTime;
+        busy = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+               (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+
+        if ( gTamer.jobs.busyTime != 0 && busy != gTamer.jobs.busyTime )
+        {
+            gTamer.jobs.machineUse  = 100.0 - (double) (idle - gTamer.jobs.idleTime) * 100.0 / (double) (busy - gTamer.jobs.busyTime);
+            gTamer.jobs.machineBusy = (busy - gTamer.jobs.busyTime) - (idle - gTamer.jobs.idleTime);
+        }
+
+        machineElapsed         = now - gTamer.jobs.sampleTick;
+        gTamer.jobs.idleTime   = idle;
+        gTamer.jobs.busyTime   = busy;
+        gTamer.jobs.sampleTick = now;
+    }
+
+    EnterCriticalSection(&gTamer.jobs.lock);
+
+    LL_FOREACH(gTamer.jobs.list, job)
+    {
+        if ( QueryInformationJobObject(job->hJob, JobObjectBasicAndIoAccountingInformation, &accounting, sizeof(accounting), NULL) == FALSE )
+            continue;
+
+        cpuTime = (uint64_t) accounting.BasicInfo.TotalUserTime.QuadPart + (uint64_t) accounting.BasicInfo.TotalKernelTime.QuadPart;
+        ioBytes = accounting.IoInfo.ReadTransferCount + accounting.IoInfo.WriteTransferCount + accounting.IoInfo.OtherTransferCount;
+        elapsed = now - job->sampleTick;
+
+        /* Processor time is in 100ns units, 10000 per millisecond */
+        job->cpuDelta = job->sampleTick != 0 ? cpuTime - job->cpuTime : 0;
+        if ( job->sampleTick != 0 && elapsed != 0 )
+        {
+            job->cpuRate = (uint32_t) ((cpuTime - job->cpuTime) / 100 / elapsed);
+            job->ioRate  = (ioBytes - job->ioBytes) * 1000 / 1024 / elapsed;
+
+            /* The job totals include the exited processes, a swarm of short lived ones hogs as much as a single busy one */
+            job->hog = gTamer.config->hogCpu != 0 && job->cpuRate >= gTamer.config->hogCpu;
+            if ( job->hog )
+                job->hogChecks++;
+        }
+
+        job->sampleTick = now;
+        job->cpuTime    = cpuTime;
+        job->ioBytes    = ioBytes;
+
+        if ( QueryInformationJobObject(job->hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL) )
+            job->peakMemory = limits.PeakJobMemoryUsed;
+    }
+
+    Tamer_JobsControl(machineElapsed);
+
+    LeaveCriticalSection(&gTamer.jobs.lock);
+}
+
+/**
+ * @brief Open the energy meters of the machine, summing their package channels.
+ * RAPL based meters expose one channel per domain (package, cores, graphics, DRAM),
+ * only the package ones are summed since they include the others. A meter without any
+ * package channel contributes its first channel.
+ */
+
+static void Tamer_EnergyOpen(void)
+{
+    HDEVINFO                         hDevInfo;
+    SP_DEVICE_INTERFACE_DATA         interfaceData;
+    SP_DEVICE_INTERFACE_DETAIL_DATA *detail;
+    EMI_VERSION                      version;
+    EMI_METADATA_SIZE                metadataSize;
+    EMI_METADATA_V2                 *metadata;
+    EMI_CHANNEL_V2                  *channel;
+    DWORD                            size, bytes;
+    WCHAR                            channelName[64];
+
+    gTamer.energy.opened = true;
+
+    hDevInfo = SetupDiGetClassDevs(&GUID_DEVICE_ENERGY_METER, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if ( hDevInfo == INVALID_HANDLE_VALUE )
+        return;
+
+    interfaceData.cbSize = sizeof(interfaceData);
+    for ( DWORD i = 0;
+          gTamer.energy.meterCount < SRVC_TAME_ENERGY_METERS && SetupDiEnumDeviceInterfaces(hDevInfo, NULL, &GUID_DEVICE_ENERGY_METER, i, &interfaceData); i++ )
+    {
+        Tamer_EnergyMeter *meter = &gTamer.energy.meters[gTamer.energy.meterCount];
+
+        size = 0;
+        SetupDiGetDeviceInterfaceDetail(hDevInfo, &interfaceData, NULL, 0, &size, NULL);
+        if ( size < sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA) )
+            continue;
+
+        detail = (SP_DEVICE_INTERFACE_DETAIL_DATA *) malloc(size);
+        if ( detail == NULL )
+            continue;
+
+        detail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
+        memset(meter, 0, sizeof(Tamer_EnergyMeter));
+        if ( SetupDiGetDeviceInterfaceDetail(hDevInfo, &interfaceData, detail, size, NULL, NULL) )
+            meter->hDevice = CreateFile(detail->DevicePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        free(detail);
+        if ( meter->hDevice == NULL || meter->hDevice == INVALID_HANDLE_VALUE )
+            continue;
+
+        if ( DeviceIoControl(meter->hDevice, IOCTL_EMI_GET_VERSION, NULL, 0, &version, sizeof(version), &bytes, NULL) == FALSE )
+        {
+            CloseHandle(meter->hDevice);
+            continue;
+        }
+
+        meter->version      = version.EmiVersion;
+        meter->channelCount = 1;
+        meter->channels     = 1;
+
+        /* Version 1 meters have a single channel, version 2 ones describe theirs in the metadata */
+        if ( meter->version >= EMI_VERSION_V2 &&
+             DeviceIoControl(meter->hDevice, IOCTL_EMI_GET_METADATA_SIZE, NULL, 0, &metadataSize, sizeof(metadataSize), &bytes, NULL) &&
+             (metadata = (EMI_METADATA_V2 *) malloc(metadataSize.MetadataSize)) != NULL )
+        {
+            if ( DeviceIoControl(meter->hDevice, IOCTL_EMI_GET_METADATA, NULL, 0, metadata, metadataSize.MetadataSize, &bytes, NULL) &&
+                 metadata->ChannelCount > 0 && metadata->ChannelCount <= 64 )
+            {
+                meter->channelCount = metadata->ChannelCount;
+                meter->channels     = 0;
+                channel             = &metadata->Channels[0];
+
+                for ( uint16_t c = 0; c < metadata->ChannelCount; c++ )
+                {
+                    size = channel->ChannelNameSize < sizeof(channelName) - sizeof(WCHAR) ? channel->ChannelNameSize : sizeof(channelName) - sizeof(WCHAR);
+                    memcpy(channelName, channel->ChannelName, size);
+                    channelName[size / sizeof(WCHAR)] = 0;
+
+                    if ( wcsstr(channelName, L"PKG") != NULL )
+                        meter->channels |= (uint64_t) 1 << c;
+
+                    channel = EMI_CHANNEL_V2_NEXT_CHANNEL(channel);
+                }
+
+                if ( meter->channels == 0 )
+                    meter->channels = 1;
+            }
+
+            free(metadata);
+        }
+
+        gTamer.energy.meterCount++;
+    }
+
+    SetupDiDestroyDeviceInfoList(hDevInfo);
+}
+
+/**
+ * @brief Read the cumulative energy of the machine.
+ * @param energy Output energy counter, microjoules.
+ * @return true on success, false when no energy source is available.
+ */
+
+static bool Tamer_EnergyRead(uint64_t *energy)
+{
+    EMI_CHANNEL_MEASUREMENT_DATA measurements[64];
+    unsigned long long           counter = 0;
+    uint64_t                     picowattHours = 0;
+    DWORD                        bytes, size;
+    FILE                        *file;
+    bool                         retVal = false;
+
+    /* A stand-in counter file, as a powercap energy_uj, takes over the meters */
+    if ( gTamer.config->energyFile[0] != 0 )
+    {
+        file = fopen(gTamer.config->energyFile, "r");
+        if ( file == NULL )
+            return false;
+
+        retVal = fscanf(file, "%llu", &counter) == 1;
+        fclose(file);
+
+        *energy = counter;
+        return retVal;
+    }
+
+    if ( gTamer.energy.opened == false )
+        Tamer_EnergyOpen();
+
+    for ( int i = 0; i < gTamer.energy.meterCount; i++ )
+    {
+        Tamer_EnergyMeter *meter = &gTamer.energy.meters[i];
+
+        size = meter->channelCount * sizeof(EMI_CHANNEL_MEASUREMENT_DATA);
+        if ( DeviceIoControl(meter->hDevice, IOCTL_EMI_GET_MEASUREMENT, NULL, 0, measurements, size, &bytes, NULL) == FALSE )
+            continue;
+
+        for ( uint16_t c = 0; c < meter->channelCount; c++ )
+        {
+            if ( meter->channels & ((uint64_t) 1 << c) )
+                picowattHours += measurements[c].AbsoluteEnergy;
+        }
+
+        retVal = true;
+    }
+
+    /* 1 pWh is 3.6 nJ, divided first so that the counter cannot overflow */
+    *energy = picowattHours / 10000 * 36 + picowattHours % 10000 * 36 / 10000;
+    return retVal;
+}
+
+/**
+ * @brief Measure the energy the machine uses before anything is tamed, the reference for the use since then.
+ * The first sweep waits 'EnergyBaseline' ms for it.
+ * @return false if a stop request came meanwhile, true otherwise.
+ */
+
+static bool Tamer_EnergyBaseline(void)
+{
+    uint64_t  start, end;
+    ULONGLONG tick;
+
+    if ( gTamer.config->energyBaseline == 0 || Tamer_EnergyRead(&start) == false )
+        return true;
+
+    tick = GetTickCount64();
+    if ( gTamer.hStop != NULL && WaitForSingleObject(gTamer.hStop, gTamer.config->energyBaseline) == WAIT_OBJECT_0 )
+        return false;
+    else if ( gTamer.hStop == NULL )
+        Sleep(gTamer.config->energyBaseline);
+
+    if ( Tamer_EnergyRead(&end) && end >= start )
+    {
+        gTamer.energy.baseline   = end - start;
+        gTamer.energy.baselineMs = GetTickCount64() - tick;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Account for the energy used over the last check.
+ * The share of each entry job is estimated from its part of the machine processor time, and so
+ * is the share of the tamed processes, from the processor time of their state entries.
+ */
+
+static void Tamer_EnergySample(void)
+{
+    Tamer_Job *job;
+    uint64_t   energy, used, elapsed, idle, busy, machineBusy = 0;
+    FILETIME   idleTime, kernelTime, userTime;
+    ULONGLONG  now = GetTickCount64();
+
+    if ( Tamer_EnergyRead(&energy) == false )
+        return;
+
+    if ( GetSystemTimes(&idleTime, &kernelTime, &userTime) )
+    {
+        idle = ((uint64_t) idleTime.dwHighDateTime << 32) | idleTime.dwLowDateTime;
+        busy = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+               (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+
+        if ( gTamer.energy.busyTime != 0 && busy - gTamer.energy.busyTime > idle - gTamer.energy.idleTime )
+            machineBusy = (busy - gTamer.energy.busyTime) - (idle - gTamer.energy.idleTime);
+
+        gTamer.energy.idleTime = idle;
+        gTamer.energy.busyTime = busy;
+    }
+
+    if ( gTamer.energy.last != 0 && energy >= gTamer.energy.last )
+    {
+        used    = energy - gTamer.energy.last;
+        elapsed = now - gTamer.energy.lastTick;
+
+        gTamer.energy.total += used;
+        gTamer.energy.totalMs += elapsed;
+
+        if ( machineBusy != 0 )
+        {
+            if ( gTamer.energy.tamedCpu > machineBusy )
+                gTamer.energy.tamedCpu = machineBusy;
+            gTamer.energy.tamed += (uint64_t) ((double) used * (double) gTamer.energy.tamedCpu / (double) machineBusy);
+        }
+
+        if ( gTamer.jobs.hPort != NULL && gTamer.jobs.machineBusy != 0 )
+        {
+            EnterCriticalSection(&gTamer.jobs.lock);
+            LL_FOREACH(gTamer.jobs.list, job)
+            {
+                job->energy += (uint64_t) ((double) used * (double) job->cpuDelta / (double) gTamer.jobs.machineBusy);
+            }
+            LeaveCriticalSection(&gTamer.jobs.lock);
+        }
+    }
+
+    gTamer.energy.last     = energy;
+    gTamer.energy.lastTick = now;
+    gTamer.energy.tamedCpu = 0;
+}
+
+/**
+ * @brief Write the energy statistics section.
+ * @param file Statistics file.
+ */
+
+static void Tamer_StatsEnergy(FILE *file)
+{
+    /* A microjoule per millisecond is a milliwatt, 3.6 joules per hour */
+    fprintf(file, "[Energy]\nSource=%s\nJoules=%llu\nJoulesPerHour=%llu\nBaselineJoulesPerHour=%llu\nBaselineMs=%llu\nTamedJoules=%llu\nTamedShare=%.1f\n\n",
+            gTamer.config->energyFile[0] != 0 ? "File" : "EMI", (unsigned long long) (gTamer.energy.total / 1000000),
+            (unsigned long long) (gTamer.energy.totalMs ? gTamer.energy.total * 36 / 10 / gTamer.energy.totalMs : 0),
+            (unsigned long long) (gTamer.energy.baselineMs ? gTamer.energy.baseline * 36 / 10 / gTamer.energy.baselineMs : 0),
+            (unsigned long long) gTamer.energy.baselineMs, (unsigned long long) (gTamer.energy.tamed / 1000000),
+            gTamer.energy.total ? (double) gTamer.energy.tamed * 100.0 / (double) gTamer.energy.total : 0.0);
+}
+
+/**
+ * @brief Release every job object, lifting their limits.
+ */
+
+static void Tamer_JobsReset(void)
+{
+    while ( gTamer.jobs.list != NULL )
+        Tamer_JobRelease(gTamer.jobs.list);
+}
+
+/**
+ * @brief Set the resource properties of the background job object from the configuration.
+ * A CPU weight shares the processors with the other weighted jobs by weight, and a memory
+ * ceiling trims the working set of each process beyond it rather than failing allocations.
+ * @param enable true to apply the configured properties, false to lift them.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_SliceConfigure(bool enable)
+{
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION   limits;
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION cpuRate;
+    bool                                   retVal = true;
+
+    if ( gTamer.slice.hJob == NULL )
+        return true;
+
+    memset(&cpuRate, 0, sizeof(cpuRate));
+    if ( enable && gTamer.config->sliceCpuWeight > 0 )
+    {
+        cpuRate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED;
+        cpuRate.Weight       = gTamer.config->sliceCpuWeight > 9 ? 9 : gTamer.config->sliceCpuWeight;
+    }
+
+    if ( SetInformationJobObject(gTamer.slice.hJob, JobObjectCpuRateControlInformation, &cpuRate, sizeof(cpuRate)) == FALSE )
+        retVal = false;
+
+    memset(&limits, 0, sizeof(limits));
+    if ( enable && gTamer.config->sliceMemoryHigh > 0 )
+    {
+        limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_WORKINGSET;
+        limits.BasicLimitInformation.MinimumWorkingSetSize = SRVC_TAME_SLICE_WS_MIN;
+        limits.BasicLimitInformation.MaximumWorkingSetSize = (SIZE_T) gTamer.config->sliceMemoryHigh * 1024 * 1024;
+    }
+
+    if ( SetInformationJobObject(gTamer.slice.hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits)) == FALSE )
+        retVal = false;
+
+    return retVal;
+}
+
+/**
+ * @brief Lift the properties of the background job object, its processes cannot leave it.
+ */
+
+static void Tamer_SliceReset(void)
+{
+    Tamer_SliceConfigure(false);
+}
+
+/**
+ * @brief Console control handler, leaves no process frozen behind when the console process is stopped.
+ * It runs on its own thread while a sweep may be using the groups and jobs: it only asks the loop
+ * to stop, and waits for it to have released everything, as a service stop does.
+ * @param type Control event.
+ * @retval BOOL TRUE, the loop ends the process.
+ */
+
+static BOOL WINAPI Tamer_ConsoleControl(DWORD type)
+{
+    (void) type;
+
+    SetEvent(gTamer.hStop);
+    WaitForSingleObject(gTamer.hStopped, SRVC_TAME_STOP_WAIT_HINT);
+    return TRUE;
+}
+
+/** 
+ * @brief reads the .INI file into the session configuration global.
+ * After the first read the function will do nothing if the 
+ * configuration crc32 is the same as the previous run crc.
+ * @return number of items in the process list or 0 on error.
+ */
+
+static int Tamer_ReadConfig(void)
+{
+
+    int         retVal            = 0;
+    char        iniFile[MAX_PATH] = {0};
+    uint32_t    crc32;
+    Tamer_Proc *el, *tmp;
+
+    do
+    {
+        if ( gTamer.config == NULL )
+        {
+            /* First run, allocate the thing */
+            gTamer.config = (Tamer_Config *) malloc(sizeof(Tamer_Config));
+            if ( gTamer.config == 0 )
+                return 0;
+
+            memset(gTamer.config, 0, sizeof(Tamer_Config));
+        }
+
+        /* Figure the configuration file name and path, data files stay in the default location whatever the file */
+        if ( gTamer.config->dataPath[0] == 0 )
+        {
+            if ( gTamer.serviceMode == true )
+            {
+                /* When running as a service we expect the .ini to be in the  \Windsows directory. */
+                if ( GetWindowsDirectory(iniFile, MAX_PATH) == 0 )
+                    break;
+            }
+            else
+            {
+                /* When not running as a service we expect the .ini to be in the local path. */
+                if ( GetCurrentDirectory(MAX_PATH, iniFile) == 0 )
+                    break;
+            }
+
+            if ( gTamer.configFile != NULL )
+                snprintf(gTamer.config->filePath, MAX_PATH, "%s", gTamer.configFile);
+            else
+                snprintf(gTamer.config->filePath, MAX_PATH, "%s\\%s", iniFile, SRVC_TAME_INI_FILE);
+
+            snprintf(gTamer.config->dataPath, MAX_PATH, "%s", iniFile);
+        }
+
+        /* Get the configuration file CRC to see if we have to read it again */
+        crc32 = Tamer_GetFileCRC(gTamer.config->filePath);
+        if ( crc32 == 0 )
+            break;
+
+        /* If we got a crc that is different from the previous one invalidate the processes list */
+        if ( crc32 != gTamer.config->crc32 )
+        {
+
+            /* Get the service display name, description and interval */
+
+            gTamer.config->serviceDispalyName[0] = 0;
+            GetPrivateProfileString("Service", "DisplayName", SRVC_TAME_SERVICE_DISPLAY_NAME, gTamer.config->serviceDispalyName,
+                                    sizeof(((Tamer_Config *) 0)->serviceDispalyName) - 1, gTamer.config->filePath);
+
+            gTamer.config->serviceDescription[0] = 0;
+            GetPrivateProfileString("Service", "Description", SRVC_TAME_SERVICE_DESCRIPTION, gTamer.config->serviceDescription,
+                                    sizeof(((Tamer_Config *) 0)->serviceDescription) - 1, gTamer.config->filePath);
+
+            gTamer.config->interval         = GetPrivateProfileInt("Service", "Interval", SRVC_TAME_INTERVAL, gTamer.config->filePath);
+            gTamer.config->statsInterval    = GetPrivateProfileInt("Service", "StatsInterval", SRVC_TAME_STATS_INTERVAL, gTamer.config->filePath);
+            gTamer.config->handleCacheSize  = (int) GetPrivateProfileInt("Service", "HandleCache", SRVC_TAME_HANDLE_CACHE_AUTO, gTamer.config->filePath);
+            gTamer.config->selfProtect      = GetPrivateProfileInt("Service", "SelfProtect", 0, gTamer.config->filePath) != 0;
+            gTamer.config->inversionThreads = GetPrivateProfileInt("Service", "InversionThreads", 0, gTamer.config->filePath);
+            gTamer.config->pluginBudget     = GetPrivateProfileInt("Service", "PluginBudget", SRVC_TAME_PLUGIN_BUDGET, gTamer.config->filePath);
+            gTamer.config->sweepThreads     = (int) GetPrivateProfileInt("Service", "SweepThreads", SRVC_TAME_SWEEP_THREADS_AUTO, gTamer.config->filePath);
+            gTamer.config->coalesceMax      = GetPrivateProfileInt("Service", "CoalesceMax", SRVC_TAME_COALESCE_MAX, gTamer.config->filePath);
+
+            gTamer.config->energyFile[0] = 0;
+            GetPrivateProfileString("Service", "EnergyFile", "", gTamer.config->energyFile, sizeof(gTamer.config->energyFile) - 1, gTamer.config->filePath);
+            gTamer.config->energyBaseline = GetPrivateProfileInt("Service", "EnergyBaseline", SRVC_TAME_ENERGY_BASELINE, gTamer.config->filePath);
+
+            gTamer.config->sliceName[0] = 0;
+            GetPrivateProfileString("Service", "Slice", SRVC_TAME_SLICE_NAME, gTamer.config->sliceName, sizeof(gTamer.config->sliceName) - 1,
+                                    gTamer.config->filePath);
+            gTamer.config->sliceCpuWeight  = GetPrivateProfileInt("Service", "SliceCpuWeight", 0, gTamer.config->filePath);
+            gTamer.config->sliceMemoryHigh = GetPrivateProfileInt("Service", "SliceMemoryHigh", 0, gTamer.config->filePath);
+
+            gTamer.config->hogCpu           = GetPrivateProfileInt("Service", "HogCpu", SRVC_TAME_HOG_CPU, gTamer.config->filePath);
+            gTamer.config->trimIdleCpu      = GetPrivateProfileInt("Service", "TrimIdleCpu", SRVC_TAME_TRIM_IDLE_CPU, gTamer.config->filePath);
+            gTamer.config->serializeIdleCpu = GetPrivateProfileInt("Service", "SerializeIdleCpu", SRVC_TAME_SERIALIZE_IDLE_CPU, gTamer.config->filePath);
+            gTamer.config->serializeIdleIo  = GetPrivateProfileInt("Service", "SerializeIdleIo", SRVC_TAME_SERIALIZE_IDLE_IO, gTamer.config->filePath);
+
+            /* Processes whose waits on tamed processes must not be slowed down, on top of the foreground one */
+            gTamer.config->protectedCount = 0;
+            for ( int i = 0; i < SRVC_TAME_PROTECTED_MAX; i++ )
+            {
+                char protectedEntry[64];
+
+                snprintf(protectedEntry, sizeof(protectedEntry), "Protected%d_Name", i + 1);
+                if ( GetPrivateProfileString("Protected", protectedEntry, "", gTamer.config->protectedNames[i], sizeof(gTamer.config->protectedNames[i]) - 1,
+                                             gTamer.config->filePath) == 0 )
+                    break;
+
+                gTamer.config->protectedCount++;
+            }
+
+            /* Until a sweep tells how many processes get tamed an auto sized cache may grow up to its bound */
+            gTamer.handleCache.capacity =
+                gTamer.config->handleCacheSize == SRVC_TAME_HANDLE_CACHE_AUTO ? SRVC_TAME_HANDLE_CACHE_MAX : gTamer.config->handleCacheSize;
+
+            /* Instances limits refer to the entries, thaw everything and count again */
+            Tamer_LimitReset();
+
+            /* Release the compiled matcher and the process list */
+            Tamer_MatcherFree(&gTamer.config->matcher);
+            LL_FOREACH_SAFE(gTamer.config->procList, el, tmp)
+            {
+                free(el); /* Release the node */
+            }
+
+            gTamer.config->procList     = NULL;
+            gTamer.config->housekeeping = 0;
+            gTamer.config->threadRules  = false;
+            gTamer.config->crc32        = crc32; /* Update our session the current crc32 */
+
+            /* Plugins are reloaded along with the list since entries refer to them */
+            Tamer_PluginsLoad();
+
+            /* Construct a new list based on the configuration file */
+            char  configEntry[256];
+            char  valueText[(SRVC_TAME_SHA256_SIZE * 2) + 8];
+            int   processIndex = 1;
+            DWORD bufferSize   = sizeof(((Tamer_Proc *) 0)->procName);
+
+            while ( 1 )
+            {
+                /* Build the list */
+                el = (Tamer_Proc *) malloc(sizeof(Tamer_Proc));
+                if ( el != NULL )
+                {
+                    /* Get the process name and / or the executable hash, an entry needs at least one of them */
+                    memset(el, 0, sizeof(Tamer_Proc));
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Name", processIndex);
+                    GetPrivateProfileString("Processes", configEntry, "", el->procName, bufferSize - 1, gTamer.config->filePath);
+
+                    configEntry[0] = 0;
+                    valueText[0]   = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Hash", processIndex);
+                    if ( GetPrivateProfileString("Processes", configEntry, "", valueText, sizeof(valueText) - 1, gTamer.config->filePath) != 0 )
+                        el->hasHash = Tamer_HexToHash(valueText, el->hash);
+
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Path", processIndex);
+                    GetPrivateProfileString("Processes", configEntry, "", el->procPath, sizeof(el->procPath) - 1, gTamer.config->filePath);
+
+                    if ( el->procName[0] == 0 && el->hasHash == false && el->procPath[0] == 0 )
+                    {
+                        free(el);
+                        el = NULL;
+                        break;
+                    }
+                    /* Get the process tamed priority, a level out of range is ignored rather than guessed */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Prio", processIndex);
+                    el->priority = (int) GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
+
+                    /* With a thread name pattern the priority goes to the matching threads only, not to the process */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Threads", processIndex);
+                    if ( el->priority < 0 || el->priority > SRVC_TAME_PRIO_MAX )
+                    {
+                        /* Neither the process nor its threads get a priority, the other settings still apply */
+                    }
+                    else if ( GetPrivateProfileString("Processes", configEntry, "", el->threadPattern, sizeof(el->threadPattern) - 1,
+                                                      gTamer.config->filePath) != 0 )
+                    {
+                        el->action.fields |= TAMER_ACTION_THREADS;
+                        el->action.threadPriority = Tamer_ThreadPriority(el->priority);
+                        el->action.threadPattern  = el->threadPattern;
+                        gTamer.config->threadRules = true;
+                    }
+                    else
+                    {
+                        el->action.fields |= TAMER_ACTION_PRIORITY;
+                        el->action.priorityClass = Tamer_PriorityClass(el->priority);
+                    }
+
+                    /* Get the explicit precedence used to settle entries matching the same process */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Precedence", processIndex);
+                    el->precedence = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
+
+                    /* Get the optional housekeeping processors mask and power throttling */
+                    configEntry[0] = 0;
+                    valueText[0]   = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Cpus", processIndex);
+                    if ( GetPrivateProfileString("Processes", configEntry, "", valueText, sizeof(valueText) - 1, gTamer.config->filePath) != 0 )
+                    {
+                        el->action.affinity = (DWORD_PTR) strtoull(valueText, NULL, 16);
+                        if ( el->action.affinity != 0 )
+                        {
+                            el->action.fields |= TAMER_ACTION_AFFINITY;
+                            gTamer.config->housekeeping |= el->action.affinity;
+                        }
+                    }
+
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_EcoQoS", processIndex);
+                    if ( GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath) != 0 )
+                    {
+                        el->action.fields |= TAMER_ACTION_ECOQOS;
+                        el->action.ecoQoS = true;
+                    }
+
+                    /* Get the optional I/O priority hint, 0 very low, 1 low, 2 normal */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_IoPrio", processIndex);
+                    el->action.ioPriority = GetPrivateProfileInt("Processes", configEntry, 0xFF, gTamer.config->filePath);
+                    if ( el->action.ioPriority <= TAMER_IO_PRIORITY_NORMAL )
+                        el->action.fields |= TAMER_ACTION_IOPRIO;
+
+                    /* Get the optional memory priority, 1 very low to 5 normal, and working set trimming of idle processes */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_MemPrio", processIndex);
+                    el->action.memoryPriority = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
+                    if ( el->action.memoryPriority >= MEMORY_PRIORITY_VERY_LOW && el->action.memoryPriority <= MEMORY_PRIORITY_NORMAL )
+                        el->action.fields |= TAMER_ACTION_MEMPRIO;
+
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Trim", processIndex);
+                    if ( GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath) != 0 )
+                        el->action.fields |= TAMER_ACTION_TRIM;
+
+                    /* Get the optional plugin, an extra condition and / or a batch action */
+                    configEntry[0] = 0;
+                    valueText[0]   = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Plugin", processIndex);
+                    el->action.plugin = -1;
+                    if ( GetPrivateProfileString("Processes", configEntry, "", valueText, sizeof(valueText) - 1, gTamer.config->filePath) != 0 )
+                    {
+                        el->action.plugin = Tamer_PluginFind(valueText);
+                        if ( el->action.plugin < 0 )
+                            el->action.plugin = SRVC_TAME_PLUGIN_MISSING; /* Its condition cannot be checked, never match */
+                        if ( el->action.plugin >= 0 && gTamer.plugins[el->action.plugin].api.batch != NULL )
+                            el->action.fields |= TAMER_ACTION_PLUGIN;
+                    }
+
+                    /* Get the optional limit of matching processes running at once, extras are frozen */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_MaxInstances", processIndex);
+                    el->maxInstances = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
+                    if ( el->maxInstances > 0 )
+                    {
+                        el->action.fields |= TAMER_ACTION_LIMIT;
+                        el->action.limitRule = el;
+                    }
+
+                    /* Get the optional active processes limit, the process tree is then contained in a job object */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_MaxProcesses", processIndex);
+                    el->maxProcesses = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Account", processIndex);
+                    el->account = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath) != 0;
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_CpuTarget", processIndex);
+                    el->cpuTarget = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath);
+                    if ( el->cpuTarget > 100 )
+                        el->cpuTarget = 100;
+
+                    if ( el->maxProcesses > 0 || el->account || el->cpuTarget > 0 )
+                    {
+                        el->action.fields |= TAMER_ACTION_JOB;
+                        el->action.jobRule = el;
+                    }
+
+                    /* Get the optional move into the shared background job object */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Slice", processIndex);
+                    if ( GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath) != 0 )
+                        el->action.fields |= TAMER_ACTION_SLICE;
+
+                    /* Get the optional serialize group, its members take turns to run */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Serialize", processIndex);
+                    if ( GetPrivateProfileString("Processes", configEntry, "", el->serializeGroup, sizeof(el->serializeGroup) - 1,
+                                                 gTamer.config->filePath) != 0 )
+                    {
+                        el->action.fields |= TAMER_ACTION_SERIALIZE;
+                        el->action.serializeRule = el;
+                    }
+
+                    /* Exclusions share the index with the other entries and simply win over them */
+                    configEntry[0] = 0;
+                    snprintf(configEntry, sizeof(configEntry), "Process%d_Exclude", processIndex);
+                    el->exclude = GetPrivateProfileInt("Processes", configEntry, 0, gTamer.config->filePath) != 0;
+                    el->index   = processIndex;
+                }
+
+                if ( el == NULL )
+                    break;
+
+                /* Add to the list */
+                LL_APPEND(gTamer.config->procList, el);
+
+                processIndex++;
+            }
+
+            /* Existing job objects follow their entries */
+            Tamer_JobsReconcile();
+            Tamer_SliceConfigure(true);
+
+            /* Compile the new list */
+            if ( Tamer_MatcherBuild(&gTamer.config->matcher, gTamer.config->procList) == false )
+            {
+                gTamer.config->crc32 = 0; /* Try again next round */
+                break;
+            }
+        }
+
+        /* Return the items we have in the process list */
+        LL_COUNT(gTamer.config->procList, el, retVal);
+
+    } while ( 0 );
+
+    return retVal;
+}
+
+/**
+ * @brief Uninstalls the service.
+ * @param serviceName Name of the service to uninstall.
+ * @retval int EXIT_SUCCESS on success, EXIT_FAILURE on failure.
+ */
+
+static int Tamer_ServiceUninstall(const char *serviceName)
+{
+    int       retVal     = EXIT_FAILURE;
+    SC_HANDLE hSCManager = OpenSCManager(NULL, NULL, SC_MANAGER_ALL_ACCESS);
+
+    if ( hSCManager && serviceName )
+    {
+        SC_HANDLE hService = OpenService(hSCManager, serviceName, SERVICE_STOP | DELETE);
+        if ( hService )
+        {
+            SERVICE_STATUS status;
+            if ( ControlService(hService, SERVICE_CONTROL_STOP, &status) )
+            {
+
+                Sleep(1000);
+                while ( QueryServiceStatus(hService, &status) )
+                {
+                    if ( status.dwCurrentState == SERVICE_STOP_PENDING )
                         Sleep(500);
                     else
                         break;
                 }
             }
 
-            if ( DeleteService(hService) )
-                retVal = EXIT_SUCCESS;
+            if ( DeleteService(hService) )
+                retVal = EXIT_SUCCESS;
+
+            CloseServiceHandle(hService);
+        }
+
+        CloseServiceHandle(hSCManager);
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Installs the service.
+ * @param procName Name of the executable to run as service.
+ * @retval int EXIT_SUCCESS on success, EXIT_FAILURE on failure.
+ */
+
+static int Tamer_ServiceInstall(char *procName, const char *serviceName, const char *serviceDisplayName, const char *serviceDescription)
+{
+    int       retVal     = EXIT_FAILURE;
+    char      path[512]  = {0};
+    SC_HANDLE hSCManager = OpenSCManager(NULL, NULL, SC_MANAGER_CREATE_SERVICE);
+
+    if ( hSCManager )
+    {
+        GetFullPathName(procName, sizeof(path), path, NULL);
+
+        SC_HANDLE hService = CreateService(hSCManager, serviceName, serviceDisplayName, SERVICE_ALL_ACCESS, SERVICE_WIN32_OWN_PROCESS, SERVICE_AUTO_START,
+                                           SERVICE_ERROR_NORMAL, path, NULL, NULL, NULL, NULL, NULL);
+
+        if ( hService )
+        {
+            SERVICE_DESCRIPTION desc;
+            desc.lpDescription = (LPSTR) serviceDescription;
+
+            if ( ChangeServiceConfig2(hService, SERVICE_CONFIG_DESCRIPTION, &desc) )
+                retVal = EXIT_SUCCESS;
+            CloseServiceHandle(hService);
+        }
+
+        CloseServiceHandle(hSCManager);
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Checks the predicates of a configured entry other than the name, which the index already took care of.
+ * The executable path and digest are resolved at most once per process and only when an entry needs them.
+ * @param proc Pointer to the configured entry.
+ * @param pEntry Pointer to the snapshot entry of the running process.
+ * @param ident Pointer to the lazily resolved identity of the running process.
+ * @retval bool true if the process matches the entry.
+ */
+
+static bool Tamer_ProcessMatch(Tamer_Proc *proc, PROCESSENTRY32 *pEntry, Tamer_ProcIdentity *ident)
+{
+    SrvcTame_PluginProcess process;
+    Tamer_Plugin          *plugin;
+    LARGE_INTEGER          start, end;
+    bool                   match;
+
+    if ( proc->action.plugin == SRVC_TAME_PLUGIN_MISSING )
+        return false;
+
+    if ( proc->action.plugin >= 0 && gTamer.plugins[proc->action.plugin].api.match != NULL )
+    {
+        plugin = &gTamer.plugins[proc->action.plugin];
+
+        /* Like a missing one, a disabled plugin can no longer check its condition */
+        if ( plugin->disabled )
+            return false;
+
+        Tamer_PluginProcess(pEntry, &process);
+        QueryPerformanceCounter(&start);
+        match = plugin->api.match(plugin->api.context, &process);
+        QueryPerformanceCounter(&end);
+
+        plugin->matches++;
+        plugin->sweepTicks += end.QuadPart - start.QuadPart;
+        if ( match == false )
+            return false;
+    }
+
+    if ( proc->procPath[0] == 0 && proc->hasHash == false )
+        return true;
+
+    if ( ident->pathQueried == false )
+    {
+        ident->pathQueried = true;
+        ident->pathValid   = Tamer_GetProcessPath(pEntry->th32ProcessID, ident->path);
+    }
+
+    if ( ident->pathValid == false )
+        return false;
+
+    if ( proc->procPath[0] != 0 && _strnicmp(ident->path, proc->procPath, strlen(proc->procPath)) != 0 )
+        return false;
+
+    if ( proc->hasHash == false )
+        return true;
+
+    if ( ident->hashQueried == false )
+    {
+        ident->hashQueried = true;
+        ident->hashValid   = Tamer_GetFileHash(ident->path, ident->hash);
+    }
+
+    return ident->hashValid && memcmp(ident->hash, proc->hash, SRVC_TAME_SHA256_SIZE) == 0;
+}
+
+/**
+ * @brief Work out the single composite action for a running process.
+ * The row of the process name is walked in precedence order: each matching entry
+ * contributes the action fields that no higher entry already set, a matching exclusion
+ * ends the walk, and so does reaching entries that could not add anything.
+ * @param matcher Pointer to the compiled matcher.
+ * @param pEntry Pointer to the snapshot entry of the running process.
+ * @param ident Pointer to the lazily resolved identity of the running process.
+ * @param action Output composite action, 'fields' is 0 when there is nothing to do.
+ */
+
+static void Tamer_MatcherDecide(Tamer_Matcher *matcher, PROCESSENTRY32 *pEntry, Tamer_ProcIdentity *ident, Tamer_Action *action)
+{
+    char            name[sizeof(((Tamer_Proc *) 0)->procName)];
+    Tamer_NameSlot *slot;
+    Tamer_Proc     *proc;
+    uint32_t        newFields;
+
+    memset(action, 0, sizeof(Tamer_Action));
+
+    if ( matcher->ruleCount == 0 )
+        return;
+
+    Tamer_ToLower(name, pEntry->szExeFile, sizeof(name));
+    slot = Tamer_MatcherSlot(matcher, name);
+    if ( slot->procName[0] == 0 )
+        slot = &matcher->unnamed;
+
+    for ( int i = 0; i < slot->count; i++ )
+    {
+        if ( (slot->remaining[i] & ~action->fields) == 0 )
+            break;
+
+        proc = matcher->rules[slot->rules[i]];
+        if ( Tamer_ProcessMatch(proc, pEntry, ident) == false )
+            continue;
+
+        if ( proc->exclude )
+            break;
+
+        newFields = proc->action.fields & ~action->fields;
+        if ( newFields & TAMER_ACTION_PRIORITY )
+            action->priorityClass = proc->action.priorityClass;
+        if ( newFields & TAMER_ACTION_AFFINITY )
+            action->affinity = proc->action.affinity;
+        if ( newFields & TAMER_ACTION_ECOQOS )
+            action->ecoQoS = proc->action.ecoQoS;
+        if ( newFields & TAMER_ACTION_IOPRIO )
+            action->ioPriority = proc->action.ioPriority;
+        if ( newFields & TAMER_ACTION_MEMPRIO )
+            action->memoryPriority = proc->action.memoryPriority;
+        if ( newFields & TAMER_ACTION_PLUGIN )
+            action->plugin = proc->action.plugin;
+        if ( newFields & TAMER_ACTION_LIMIT )
+            action->limitRule = proc->action.limitRule;
+        if ( newFields & TAMER_ACTION_SERIALIZE )
+            action->serializeRule = proc->action.serializeRule;
+        if ( newFields & TAMER_ACTION_JOB )
+            action->jobRule = proc->action.jobRule;
+        if ( newFields & TAMER_ACTION_THREADS )
+        {
+            action->threadPriority = proc->action.threadPriority;
+            action->threadPattern  = proc->action.threadPattern;
+        }
+
+        action->fields |= newFields;
+    }
+}
+
+/**
+ * @brief Drop a handle from the cache and close it.
+ * @param entry Pointer to the cached entry.
+ */
+
+static void Tamer_HandleEvict(Tamer_HandleEntry *entry)
+{
+    LL_DELETE2(gTamer.handleCache.buckets[entry->pid & (SRVC_TAME_HANDLE_BUCKETS - 1)], entry, hnext);
+    DL_DELETE(gTamer.handleCache.lru, entry);
+    CloseHandle(entry->hProcess);
+    free(entry);
+    gTamer.handleCache.count--;
+}
+
+/**
+ * @brief Get a handle to a process, from the cache when possible.
+ * A cached handle whose process has exited is dropped, the PID may have been reused.
+ * When the cache is full the least recently used handle makes room.
+ * @param pid Process ID.
+ * @param startTime Output, process creation time.
+ * @param cached Output, true if the handle belongs to the cache and must not be closed.
+ * @retval HANDLE Process handle or NULL on error.
+ */
+
+static HANDLE Tamer_HandleOpen(DWORD pid, uint64_t *startTime, bool *cached)
+{
+    Tamer_HandleEntry *entry;
+    HANDLE             hProcess;
+
+    *cached = false;
+
+    LL_SEARCH_SCALAR2(gTamer.handleCache.buckets[pid & (SRVC_TAME_HANDLE_BUCKETS - 1)], entry, pid, pid, hnext);
+    if ( entry != NULL )
+    {
+        if ( WaitForSingleObject(entry->hProcess, 0) != WAIT_OBJECT_0 )
+        {
+            /* Move to the LRU head */
+            DL_DELETE(gTamer.handleCache.lru, entry);
+            DL_PREPEND(gTamer.handleCache.lru, entry);
+            entry->round = gTamer.round;
+            gTamer.handleCache.hits++;
+            *startTime = entry->startTime;
+            *cached    = true;
+            return entry->hProcess;
+        }
+
+        gTamer.handleCache.stale++;
+        Tamer_HandleEvict(entry);
+    }
+
+    gTamer.handleCache.misses++;
+
+    hProcess = OpenProcess(SRVC_TAME_PROCESS_ACCESS, FALSE, pid);
+    if ( hProcess == NULL )
+        return NULL;
+
+    *startTime = Tamer_GetStartTime(hProcess);
+    if ( gTamer.handleCache.capacity <= 0 )
+        return hProcess;
+
+    if ( gTamer.handleCache.count >= gTamer.handleCache.capacity )
+    {
+        gTamer.handleCache.evictions++;
+        Tamer_HandleEvict(gTamer.handleCache.lru->prev); /* Tail */
+    }
+
+    entry = (Tamer_HandleEntry *) malloc(sizeof(Tamer_HandleEntry));
+    if ( entry == NULL )
+        return hProcess;
+
+    memset(entry, 0, sizeof(Tamer_HandleEntry));
+    entry->pid       = pid;
+    entry->hProcess  = hProcess;
+    entry->startTime = *startTime;
+    entry->round     = gTamer.round;
+    LL_PREPEND2(gTamer.handleCache.buckets[pid & (SRVC_TAME_HANDLE_BUCKETS - 1)], entry, hnext);
+    DL_PREPEND(gTamer.handleCache.lru, entry);
+    gTamer.handleCache.count++;
+    *cached = true;
+
+    return hProcess;
+}
+
+/**
+ * @brief Release a handle obtained from Tamer_HandleOpen().
+ * @param hProcess Process handle.
+ * @param cached Value returned by Tamer_HandleOpen().
+ */
+
+static void Tamer_HandleClose(HANDLE hProcess, bool cached)
+{
+    if ( hProcess != NULL && cached == false )
+        CloseHandle(hProcess);
+}
+
+/**
+ * @brief End of sweep housekeeping: drop handles the sweep did not use, their processes
+ * are gone or no longer tamed and an open handle would keep a dead process object
+ * alive, then size the cache for the next sweep.
+ */
+
+static void Tamer_HandleTrim(void)
+{
+    Tamer_HandleEntry *entry, *tmp;
+    int                capacity = gTamer.config->handleCacheSize;
+
+    DL_FOREACH_SAFE(gTamer.handleCache.lru, entry, tmp)
+    {
+        if ( entry->round != gTamer.round )
+            Tamer_HandleEvict(entry);
+    }
+
+    /* Auto sizing follows the tamed set with some headroom for newcomers */
+    if ( capacity == SRVC_TAME_HANDLE_CACHE_AUTO )
+    {
+        capacity = (int) gTamer.tamed * 2;
+        if ( capacity < SRVC_TAME_HANDLE_CACHE_MIN )
+            capacity = SRVC_TAME_HANDLE_CACHE_MIN;
+    }
+
+    if ( capacity < 0 || capacity > SRVC_TAME_HANDLE_CACHE_MAX )
+        capacity = SRVC_TAME_HANDLE_CACHE_MAX;
+
+    gTamer.handleCache.capacity = capacity;
+
+    while ( gTamer.handleCache.count > gTamer.handleCache.capacity )
+    {
+        gTamer.handleCache.evictions++;
+        Tamer_HandleEvict(gTamer.handleCache.lru->prev);
+    }
+}
+
+/**
+ * @brief Get the page of the PID table holding a PID.
+ * PIDs are multiples of 4 on Windows, each page covers SRVC_TAME_PID_PAGE of them.
+ * @param pid Process ID.
+ * @param create true to allocate the page, and grow the directory, when missing.
+ * @retval Tamer_PidPage* Pointer to the page, NULL if missing or on error.
+ */
+
+static Tamer_PidPage *Tamer_PidPageGet(DWORD pid, bool create)
+{
+    uint32_t        index = (pid >> 2) / SRVC_TAME_PID_PAGE;
+    Tamer_PidPage **pages;
+    uint32_t        pageCount;
+
+    if ( index >= gTamer.pids.pageCount )
+    {
+        if ( create == false )
+            return NULL;
+
+        pageCount = gTamer.pids.pageCount ? gTamer.pids.pageCount : 16;
+        while ( pageCount <= index )
+            pageCount *= 2;
+
+        pages = (Tamer_PidPage **) realloc(gTamer.pids.pages, pageCount * sizeof(Tamer_PidPage *));
+        if ( pages == NULL )
+            return NULL;
+
+        memset(pages + gTamer.pids.pageCount, 0, (pageCount - gTamer.pids.pageCount) * sizeof(Tamer_PidPage *));
+        gTamer.pids.pages     = pages;
+        gTamer.pids.pageCount = pageCount;
+    }
+
+    if ( gTamer.pids.pages[index] == NULL && create )
+    {
+        gTamer.pids.pages[index] = (Tamer_PidPage *) calloc(1, sizeof(Tamer_PidPage));
+        if ( gTamer.pids.pages[index] != NULL )
+            gTamer.pids.allocated++;
+    }
+
+    return gTamer.pids.pages[index];
+}
+
+/**
+ * @brief Note that a sweep found a PID in its snapshot.
+ * @param pid Process ID.
+ */
+
+static void Tamer_PidSeen(DWORD pid)
+{
+    Tamer_PidPage *page = Tamer_PidPageGet(pid, true);
+
+    if ( page != NULL )
+        page->seen[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)] = gTamer.round;
+}
+
+/**
+ * @brief Tell whether the current sweep found a PID in its snapshot.
+ * @param pid Process ID.
+ * @return true if the PID was in the snapshot.
+ */
+
+static bool Tamer_PidAlive(DWORD pid)
+{
+    Tamer_PidPage *page = Tamer_PidPageGet(pid, false);
+
+    return page != NULL && page->seen[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)] == gTamer.round;
+}
+
+/**
+ * @brief Point the PID table at the state entry of a PID.
+ * @param pid Process ID.
+ * @param slot State entry index + 1, 0 to unlink.
+ */
+
+static void Tamer_PidLink(DWORD pid, uint32_t slot)
+{
+    Tamer_PidPage *page = Tamer_PidPageGet(pid, slot != 0);
+
+    if ( page != NULL )
+        page->slot[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)] = slot;
+}
+
+/**
+ * @brief Reuse the identity resolved for a process by an earlier sweep.
+ * The record holds a handle to the process, so a PID that still has one is the same process.
+ * @param pid Process ID.
+ * @param ident Pointer to the identity to fill, left untouched when nothing is known.
+ */
+
+static void Tamer_PidIdentityLoad(DWORD pid, Tamer_ProcIdentity *ident)
+{
+    Tamer_PidPage     *page = Tamer_PidPageGet(pid, false);
+    Tamer_PidIdentity *record;
+
+    if ( page == NULL || (record = page->ident[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)]) == NULL )
+        return;
+
+    *ident       = record->ident;
+    record->seen = gTamer.round;
+    gTamer.pids.identityHits++;
+}
+
+/**
+ * @brief Keep the identity a sweep resolved for a process, for the next sweeps.
+ * The process is opened once, its path checked again in case the PID was reused since
+ * the snapshot. A digest still being hashed is left to be asked for again.
+ * @param pid Process ID.
+ * @param ident Pointer to the identity resolved by this sweep.
+ */
+
+static void Tamer_PidIdentityStore(DWORD pid, Tamer_ProcIdentity *ident)
+{
+    Tamer_PidPage     *page;
+    Tamer_PidIdentity *record;
+    HANDLE             hProcess;
+    char               path[MAX_PATH];
+    DWORD              pathSize = MAX_PATH;
+
+    if ( ident->pathQueried == false || ident->pathValid == false )
+        return;
+
+    page = Tamer_PidPageGet(pid, true);
+    if ( page == NULL )
+        return;
+
+    record = page->ident[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)];
+    if ( record == NULL )
+    {
+        hProcess = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if ( hProcess == NULL )
+            return;
+
+        if ( QueryFullProcessImageName(hProcess, 0, path, &pathSize) == FALSE || _stricmp(path, ident->path) != 0 )
+        {
+            CloseHandle(hProcess);
+            return;
+        }
+
+        record = (Tamer_PidIdentity *) calloc(1, sizeof(Tamer_PidIdentity));
+        if ( record == NULL )
+        {
+            CloseHandle(hProcess);
+            return;
+        }
+
+        record->pid      = pid;
+        record->hProcess = hProcess;
+        page->ident[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)] = record;
+        DL_APPEND(gTamer.pids.identities, record);
+        gTamer.pids.identityCount++;
+    }
+
+    record->ident = *ident;
+    record->seen  = gTamer.round;
+    if ( record->ident.hashValid == false )
+        record->ident.hashQueried = false;
+}
+
+/**
+ * @brief Release the identities of the processes the current sweep did not find.
+ */
+
+static void Tamer_PidIdentitySweep(void)
+{
+    Tamer_PidIdentity *record, *tmp;
+    Tamer_PidPage     *page;
+
+    DL_FOREACH_SAFE(gTamer.pids.identities, record, tmp)
+    {
+        if ( record->seen == gTamer.round )
+            continue;
+
+        page = Tamer_PidPageGet(record->pid, false);
+        if ( page != NULL )
+            page->ident[(record->pid >> 2) & (SRVC_TAME_PID_PAGE - 1)] = NULL;
+
+        DL_DELETE(gTamer.pids.identities, record);
+        CloseHandle(record->hProcess);
+        free(record);
+        gTamer.pids.identityCount--;
+    }
+}
+
+/**
+ * @brief Look a process up in the state table.
+ * @param pid Process ID.
+ * @retval Tamer_StateEntry* Pointer to the entry of the PID, NULL if it is not tracked.
+ */
+
+static Tamer_StateEntry *Tamer_StateLookup(DWORD pid)
+{
+    Tamer_PidPage *page;
+    uint32_t       slot;
+
+    if ( gTamer.state.header == NULL )
+        return NULL;
+
+    page = Tamer_PidPageGet(pid, false);
+    slot = page != NULL ? page->slot[(pid >> 2) & (SRVC_TAME_PID_PAGE - 1)] : 0;
+
+    return slot != 0 ? &gTamer.state.entries[slot - 1] : NULL;
+}
+
+/**
+ * @brief Remove an entry from the state table, the last entry moves into its place
+ * so the entries in use stay contiguous.
+ * @param entry Pointer to the entry to remove.
+ */
+
+static void Tamer_StateRemove(Tamer_StateEntry *entry)
+{
+    uint32_t hole = (uint32_t) (entry - gTamer.state.entries);
+    uint32_t last = gTamer.state.header->count - 1;
+
+    Tamer_PidLink(entry->pid, 0);
+    if ( hole != last )
+    {
+        gTamer.state.entries[hole] = gTamer.state.entries[last];
+        Tamer_PidLink(gTamer.state.entries[hole].pid, hole + 1);
+    }
+
+    memset(&gTamer.state.entries[last], 0, sizeof(Tamer_StateEntry));
+    gTamer.state.header->count--;
+}
+
+/**
+ * @brief Map the state file and validate what the previous run left in it.
+ * Entries whose process is gone, or whose PID now belongs to another process (different
+ * creation time), are dropped. The remaining ones are resumed: their original priority
+ * is known, so they can be restored correctly should they stop matching.
+ * @return true if the table is usable, false otherwise.
+ */
+
+static bool Tamer_StateOpen(void)
+{
+    char     stateFile[MAX_PATH];
+    DWORD    size = sizeof(Tamer_StateHeader) + SRVC_TAME_STATE_ENTRIES * sizeof(Tamer_StateEntry);
+    DWORD    access;
+    uint8_t *view;
+
+    if ( gTamer.state.header != NULL )
+        return true;
+
+    snprintf(stateFile, MAX_PATH, "%s\\%s", gTamer.config->dataPath, SRVC_TAME_STATE_FILE);
+
+    do
+    {
+        /* A dry run works on a private copy of the table, the running service may own the file */
+        if ( gTamer.dryRun )
+        {
+            gTamer.state.hFile    = CreateFile(stateFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            gTamer.state.hMapping =
+                CreateFileMapping(gTamer.state.hFile, NULL, gTamer.state.hFile != INVALID_HANDLE_VALUE ? PAGE_WRITECOPY : PAGE_READWRITE, 0, size, NULL);
+            if ( gTamer.state.hMapping == NULL && gTamer.state.hFile != INVALID_HANDLE_VALUE )
+            {
+                /* The file is not fully grown yet, start from an empty table */
+                CloseHandle(gTamer.state.hFile);
+                gTamer.state.hFile    = INVALID_HANDLE_VALUE;
+                gTamer.state.hMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, NULL);
+            }
+        }
+        else
+        {
+            gTamer.state.hFile = CreateFile(stateFile, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if ( gTamer.state.hFile == INVALID_HANDLE_VALUE )
+                break;
+
+            gTamer.state.hMapping = CreateFileMapping(gTamer.state.hFile, NULL, PAGE_READWRITE, 0, size, NULL);
+        }
+
+        if ( gTamer.state.hMapping == NULL )
+            break;
+
+        access = gTamer.state.hFile != INVALID_HANDLE_VALUE && gTamer.dryRun ? FILE_MAP_COPY : FILE_MAP_ALL_ACCESS;
+        view   = (uint8_t *) MapViewOfFile(gTamer.state.hMapping, access, 0, 0, size);
+        if ( view == NULL )
+            break;
+
+        gTamer.state.header  = (Tamer_StateHeader *) view;
+        gTamer.state.entries = (Tamer_StateEntry *) (view + sizeof(Tamer_StateHeader));
+
+        if ( gTamer.state.header->magic != SRVC_TAME_STATE_MAGIC || gTamer.state.header->version != SRVC_TAME_STATE_VERSION ||
+             gTamer.state.header->capacity != SRVC_TAME_STATE_ENTRIES )
+        {
+            /* New file, or one left by an incompatible build */
+            memset(view, 0, size);
+            gTamer.state.header->magic    = SRVC_TAME_STATE_MAGIC;
+            gTamer.state.header->version  = SRVC_TAME_STATE_VERSION;
+            gTamer.state.header->capacity = SRVC_TAME_STATE_ENTRIES;
+            return true;
+        }
+
+        if ( gTamer.state.header->count > SRVC_TAME_STATE_ENTRIES )
+            gTamer.state.header->count = 0;
+
+        if ( gTamer.state.header->frozenCount > SRVC_TAME_STATE_FROZEN )
+            gTamer.state.header->frozenCount = 0;
+
+        /* Processes a previous run froze and could not thaw, it stopped abruptly. A dry run leaves them to the service */
+        for ( uint32_t i = 0; i < gTamer.state.header->frozenCount && gTamer.dryRun == false && gTamer.nt.ResumeProcess != NULL; i++ )
+        {
+            Tamer_StateFrozen *frozen = &gTamer.state.header->frozen[i];
+            HANDLE             hProcess;
+
+            hProcess = OpenProcess(PROCESS_SUSPEND_RESUME | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, frozen->pid);
+            if ( hProcess == NULL )
+                continue;
+
+            if ( Tamer_GetStartTime(hProcess) == frozen->startTime && gTamer.nt.ResumeProcess(hProcess) >= 0 )
+                gTamer.state.thawed++;
+
+            CloseHandle(hProcess);
+        }
+
+        if ( gTamer.dryRun == false )
+            gTamer.state.header->frozenCount = 0;
+
+        for ( uint32_t i = 0; i < gTamer.state.header->count; i++ )
+        {
+            Tamer_StateEntry *entry = &gTamer.state.entries[i];
+            HANDLE            hProcess;
+            bool              valid = false;
+
+            hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, entry->pid);
+            if ( hProcess != NULL )
+            {
+                valid = (WaitForSingleObject(hProcess, 0) != WAIT_OBJECT_0) && Tamer_GetStartTime(hProcess) == entry->startTime;
+                CloseHandle(hProcess);
+            }
+
+            if ( valid == false )
+            {
+                Tamer_StateRemove(entry);
+                i--; /* The last entry moved into this slot */
+                continue;
+            }
+
+            entry->round = 0;
+            Tamer_PidLink(entry->pid, i + 1);
+        }
+
+        gTamer.state.resumed = gTamer.state.header->count;
+        return true;
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    if ( gTamer.state.hMapping != NULL )
+        CloseHandle(gTamer.state.hMapping);
+
+    if ( gTamer.state.hFile != INVALID_HANDLE_VALUE && gTamer.state.hFile != NULL )
+        CloseHandle(gTamer.state.hFile);
+
+    memset(&gTamer.state, 0, sizeof(Tamer_State));
+    return false;
+}
+
+/**
+ * @brief Record a process the sweep is taming, noting its original priority the first time.
+ * @param pid Process ID.
+ * @param startTime Process creation time.
+ * @param priorityClass Current priority class of the process.
+ * @retval Tamer_StateEntry* Pointer to the entry, NULL if there is no table or it is full.
+ */
+
+static Tamer_StateEntry *Tamer_StateTrack(DWORD pid, uint64_t startTime, DWORD priorityClass)
+{
+    Tamer_StateEntry *entry;
+
+    if ( gTamer.state.header == NULL )
+        return NULL;
+
+    entry = Tamer_StateLookup(pid);
+    if ( entry != NULL && entry->startTime != startTime )
+    {
+        /* The PID was reused */
+        Tamer_StateRemove(entry);
+        entry = NULL;
+    }
+
+    if ( entry == NULL )
+    {
+        if ( gTamer.state.header->count >= SRVC_TAME_STATE_ENTRIES )
+            return NULL;
+
+        entry = &gTamer.state.entries[gTamer.state.header->count];
+        memset(entry, 0, sizeof(Tamer_StateEntry));
+        entry->pid           = pid;
+        entry->startTime     = startTime;
+        entry->priorityClass = priorityClass;
+        Tamer_PidLink(pid, ++gTamer.state.header->count);
+    }
+
+    entry->round = gTamer.round;
+    return entry;
+}
+
+/**
+ * @brief Resolve the native API entry points once.
+ */
+
+static void Tamer_NtInit(void)
+{
+    HMODULE hNtDll, hKernel32;
+
+    if ( gTamer.nt.loaded )
+        return;
+
+    hNtDll = GetModuleHandle("ntdll.dll");
+    if ( hNtDll != NULL )
+    {
+        gTamer.nt.SetInformationProcess   = (Tamer_NtSetInformationProcess) GetProcAddress(hNtDll, "NtSetInformationProcess");
+        gTamer.nt.QueryInformationProcess = (Tamer_NtQueryInformationProcess) GetProcAddress(hNtDll, "NtQueryInformationProcess");
+        gTamer.nt.SuspendProcess          = (Tamer_NtSuspendProcess) GetProcAddress(hNtDll, "NtSuspendProcess");
+        gTamer.nt.ResumeProcess           = (Tamer_NtSuspendProcess) GetProcAddress(hNtDll, "NtResumeProcess");
+    }
+
+    hKernel32 = GetModuleHandle("kernel32.dll");
+    if ( hKernel32 != NULL )
+        gTamer.nt.GetThreadDescription = (Tamer_GetThreadDescription) GetProcAddress(hKernel32, "GetThreadDescription");
+
+    gTamer.nt.loaded = true;
+}
+
+/**
+ * @brief Get the I/O priority hint of a process.
+ * @param hProcess Process handle.
+ * @param ioPriority Output I/O priority hint.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_GetIoPriority(HANDLE hProcess, ULONG *ioPriority)
+{
+    if ( gTamer.nt.QueryInformationProcess == NULL )
+        return false;
+
+    return gTamer.nt.QueryInformationProcess(hProcess, TAMER_PROCESS_IO_PRIORITY, ioPriority, sizeof(ULONG), NULL) >= 0;
+}
+
+/**
+ * @brief Set the I/O priority hint of a process. Unlike the priority class it is honoured
+ * by the I/O manager whatever the disk scheduler, which makes it the per process I/O weight.
+ * @param hProcess Process handle with PROCESS_SET_INFORMATION access.
+ * @param ioPriority I/O priority hint.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_SetIoPriority(HANDLE hProcess, ULONG ioPriority)
+{
+    if ( gTamer.nt.SetInformationProcess == NULL )
+        return false;
+
+    return gTamer.nt.SetInformationProcess(hProcess, TAMER_PROCESS_IO_PRIORITY, &ioPriority, sizeof(ULONG)) >= 0;
+}
+
+/**
+ * @brief Turn power throttling (EcoQoS) on or off for a process.
+ * @param hProcess Process handle with PROCESS_SET_INFORMATION access.
+ * @param enable true to throttle, false to let the system decide again.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_SetEcoQoS(HANDLE hProcess, bool enable)
+{
+    PROCESS_POWER_THROTTLING_STATE throttling;
+
+    memset(&throttling, 0, sizeof(throttling));
+    throttling.Version     = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+    throttling.ControlMask = enable ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+    throttling.StateMask   = enable ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+
+    return SetProcessInformation(hProcess, ProcessPowerThrottling, &throttling, sizeof(throttling)) != FALSE;
+}
+
+/**
+ * @brief Get the memory priority of a process.
+ * @param hProcess Process handle.
+ * @param memoryPriority Output memory priority.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_GetMemoryPriority(HANDLE hProcess, ULONG *memoryPriority)
+{
+    MEMORY_PRIORITY_INFORMATION info;
+
+    if ( GetProcessInformation(hProcess, ProcessMemoryPriority, &info, sizeof(info)) == FALSE )
+        return false;
+
+    *memoryPriority = info.MemoryPriority;
+    return true;
+}
+
+/**
+ * @brief Set the memory priority of a process.
+ * @param hProcess Process handle.
+ * @param memoryPriority Memory priority, MEMORY_PRIORITY_xxx.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_SetMemoryPriority(HANDLE hProcess, ULONG memoryPriority)
+{
+    MEMORY_PRIORITY_INFORMATION info;
+
+    info.MemoryPriority = memoryPriority;
+    return SetProcessInformation(hProcess, ProcessMemoryPriority, &info, sizeof(info)) != FALSE;
+}
+
+/**
+ * @brief Sample the processor time of a tamed process, kept in its record.
+ * @param hProcess Process handle.
+ * @param entry Pointer to the process state entry.
+ * @param cpuDelta Output, processor time since the previous sample, 100ns units.
+ * @return true if there was a previous sample to compare to.
+ */
+
+static bool Tamer_StateCpu(HANDLE hProcess, Tamer_StateEntry *entry, uint64_t *cpuDelta)
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    uint64_t cpuTime, previous;
+
+    if ( GetProcessTimes(hProcess, &creationTime, &exitTime, &kernelTime, &userTime) == FALSE )
+        return false;
+
+    cpuTime        = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+                     (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+    previous       = entry->cpuTime;
+    entry->cpuTime = cpuTime;
+
+    if ( previous == 0 || cpuTime < previous )
+        return false;
+
+    *cpuDelta = cpuTime - previous;
+    return true;
+}
+
+/**
+ * @brief Empty the working set of a tamed process that stayed idle over the last check.
+ * Its pages move to the standby and modified lists, where the memory manager compresses
+ * them or writes them out before touching the pages of busy processes. The working set
+ * is emptied once per idle period, not again until the process did some work.
+ * @param hProcess Process handle with PROCESS_SET_QUOTA access.
+ * @param entry Pointer to the process state entry.
+ * @param sampled true if its processor time since the previous sweep is known.
+ * @param cpuDelta Its processor time since the previous sweep, 100ns units.
+ */
+
+static void Tamer_TrimIdle(HANDLE hProcess, Tamer_StateEntry *entry, bool sampled, uint64_t cpuDelta)
+{
+    /* Processor time is in 100ns units, the time since the previous sweep in milliseconds */
+    if ( sampled == false || cpuDelta * 100 >= (uint64_t) gTamer.config->trimIdleCpu * gTamer.sweepGap * 10000 )
+    {
+        entry->applied &= ~TAMER_ACTION_TRIM;
+        return;
+    }
+
+    if ( (entry->applied & TAMER_ACTION_TRIM) == 0 && SetProcessWorkingSetSizeEx(hProcess, (SIZE_T) -1, (SIZE_T) -1, 0) )
+    {
+        entry->applied |= TAMER_ACTION_TRIM;
+        gTamer.trims++;
+    }
+}
+
+/**
+ * @brief Give a tamed process back some of the settings it had before it was tamed.
+ * @param hProcess Process handle with PROCESS_SET_INFORMATION access.
+ * @param entry Pointer to the process state entry.
+ * @param fields Settings to give back, TAMER_ACTION_xxx, those not applied are ignored.
+ */
+
+static void Tamer_StateRevert(HANDLE hProcess, Tamer_StateEntry *entry, uint32_t fields)
+{
+    if ( fields & entry->applied & TAMER_ACTION_AFFINITY )
+        SetProcessAffinityMask(hProcess, (DWORD_PTR) entry->affinity);
+
+    if ( fields & entry->applied & TAMER_ACTION_ECOQOS )
+        Tamer_SetEcoQoS(hProcess, false);
+
+    if ( fields & entry->applied & TAMER_ACTION_IOPRIO )
+        Tamer_SetIoPriority(hProcess, entry->ioPriority);
+
+    if ( fields & entry->applied & TAMER_ACTION_MEMPRIO )
+        Tamer_SetMemoryPriority(hProcess, entry->memoryPriority);
+
+    entry->applied &= ~(fields & (TAMER_ACTION_AFFINITY | TAMER_ACTION_ECOQOS | TAMER_ACTION_IOPRIO | TAMER_ACTION_MEMPRIO));
+}
+
+/**
+ * @brief Give a tamed process back everything it had before it was tamed.
+ * @param hProcess Process handle with PROCESS_SET_INFORMATION access.
+ * @param entry Pointer to the process state entry.
+ * @return true if the original priority could be restored.
+ */
+
+static bool Tamer_StateRestore(HANDLE hProcess, Tamer_StateEntry *entry)
+{
+    Tamer_StateRevert(hProcess, entry, entry->applied);
+
+    /* A process cannot leave a job, the slice keeps it and its bit records that it is there */
+    entry->applied &= TAMER_ACTION_SLICE;
+    return SetPriorityClass(hProcess, entry->priorityClass) != FALSE;
+}
+
+/**
+ * @brief End of sweep: give back their original priority to processes that were tamed
+ * but did not match this sweep (the configuration changed), forget exited ones.
+ * An entry is only dropped once its process is gone or has been given back its settings,
+ * a process that cannot be opened right now is tried again at the next sweep.
+ */
+
+static void Tamer_StateSweep(void)
+{
+    if ( gTamer.state.header == NULL )
+        return;
+
+    for ( uint32_t i = 0; i < gTamer.state.header->count; i++ )
+    {
+        Tamer_StateEntry *entry = &gTamer.state.entries[i];
+        HANDLE            hProcess;
+
+        if ( entry->round == gTamer.round )
+            continue;
+
+        /* A process missing from the snapshot has exited, there is nothing to give back */
+        if ( Tamer_PidAlive(entry->pid) && gTamer.dryRun )
+        {
+            printf("- %lu: back to its original settings\n", (unsigned long) entry->pid);
+            gTamer.dryRunChanges++;
+        }
+        else if ( Tamer_PidAlive(entry->pid) )
+        {
+            hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_SET_INFORMATION, FALSE, entry->pid);
+            if ( hProcess == NULL && GetLastError() != ERROR_INVALID_PARAMETER )
+                continue;
+
+            if ( hProcess != NULL )
+            {
+                bool restored = false;
+
+                /* A different creation time means the PID now belongs to another process */
+                if ( Tamer_GetStartTime(hProcess) == entry->startTime )
+                {
+                    restored = Tamer_StateRestore(hProcess, entry);
+                    if ( restored )
+                        gTamer.state.restored++;
+                }
+                else
+                    restored = true;
+
+                CloseHandle(hProcess);
+                if ( restored == false )
+                    continue;
+            }
+        }
+
+        Tamer_StateRemove(entry);
+        i--; /* The last entry moved into this slot */
+    }
+}
+
+/**
+ * @brief Enter or leave self protection.
+ * When the machine is saturated, which is exactly when taming matters, the service must
+ * not be starved itself: its class is raised so the sweep preempts the processes it tames,
+ * and a hard minimum working set keeps its small footprint resident under memory pressure.
+ * The state table is locked explicitly since the sweep walks all of it.
+ * @param enable true to protect the service, false to return to normal.
+ */
+
+static void Tamer_SelfProtect(bool enable)
+{
+    HANDLE hSelf     = GetCurrentProcess();
+    SIZE_T stateSize = SRVC_TAME_STATE_ENTRIES * sizeof(Tamer_StateEntry);
+
+    if ( enable == gTamer.protectedMode )
+        return;
+
+    if ( enable )
+    {
+        SetPriorityClass(hSelf, HIGH_PRIORITY_CLASS);
+        SetProcessWorkingSetSizeEx(hSelf, SRVC_TAME_PROTECT_WS_MIN, SRVC_TAME_PROTECT_WS_MAX, QUOTA_LIMITS_HARDWS_MIN_ENABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE);
+        if ( gTamer.state.entries != NULL )
+            VirtualLock(gTamer.state.entries, stateSize);
+    }
+    else
+    {
+        if ( gTamer.state.entries != NULL )
+            VirtualUnlock(gTamer.state.entries, stateSize);
+        SetProcessWorkingSetSizeEx(hSelf, (SIZE_T) -1, (SIZE_T) -1, QUOTA_LIMITS_HARDWS_MIN_DISABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE);
+        SetPriorityClass(hSelf, NORMAL_PRIORITY_CLASS);
+    }
+
+    gTamer.protectedMode = enable;
+}
+
+/**
+ * @brief Account for the time it took to tame a process since it was started.
+ * @param startTime Process creation time.
+ */
+
+static void Tamer_TameLatency(uint64_t startTime)
+{
+    FILETIME now;
+    uint64_t latency;
+
+    GetSystemTimeAsFileTime(&now);
+    latency = (((uint64_t) now.dwHighDateTime << 32) | now.dwLowDateTime) - startTime;
+
+    gTamer.latencyCount++;
+    gTamer.latencySum += latency;
+    if ( latency > gTamer.latencyMax )
+        gTamer.latencyMax = latency;
+}
+
+/**
+ * @brief Report the current frequency of the housekeeping processors against the others,
+ * the difference being the turbo headroom left to the foreground.
+ * @param file Statistics file.
+ */
+
+static void Tamer_StatsFrequency(FILE *file)
+{
+    SYSTEM_INFO           sysInfo;
+    Tamer_ProcessorPower *power;
+    uint64_t              sum[2] = {0}, max[2] = {0}, count[2] = {0};
+
+    GetSystemInfo(&sysInfo);
+    power = (Tamer_ProcessorPower *) calloc(sysInfo.dwNumberOfProcessors, sizeof(Tamer_ProcessorPower));
+    if ( power == NULL )
+        return;
+
+    if ( CallNtPowerInformation(ProcessorInformation, NULL, 0, power, sysInfo.dwNumberOfProcessors * sizeof(Tamer_ProcessorPower)) == 0 )
+    {
+        for ( DWORD i = 0; i < sysInfo.dwNumberOfProcessors; i++ )
+        {
+            int set = (power[i].Number < sizeof(DWORD_PTR) * 8 && (gTamer.config->housekeeping & ((DWORD_PTR) 1 << power[i].Number))) ? 1 : 0;
+
+            sum[set] += power[i].CurrentMhz;
+            max[set] += power[i].MaxMhz;
+            count[set]++;
+        }
+
+        fprintf(file, "[Frequency]\nForegroundMhz=%llu\nForegroundMaxMhz=%llu\nHousekeepingMhz=%llu\nHousekeepingMaxMhz=%llu\n\n",
+                (unsigned long long) (count[0] ? sum[0] / count[0] : 0), (unsigned long long) (count[0] ? max[0] / count[0] : 0),
+                (unsigned long long) (count[1] ? sum[1] / count[1] : 0), (unsigned long long) (count[1] ? max[1] / count[1] : 0));
+    }
+
+    free(power);
+}
+
+/**
+ * @brief Export the service counters to the statistics file, at most once per StatsInterval.
+ * The file uses the .INI format so it can be read with the same tools as the configuration.
+ */
+
+static void Tamer_StatsWrite(void)
+{
+    FILE         *file;
+    char          statsFile[MAX_PATH];
+    LARGE_INTEGER frequency;
+    Tamer_Job    *job;
+    ULONGLONG     now = GetTickCount64();
+
+    if ( gTamer.statsTick != 0 && now - gTamer.statsTick < gTamer.config->statsInterval )
+        return;
+
+    gTamer.statsTick = now;
+
+    snprintf(statsFile, MAX_PATH, "%s\\%s", gTamer.config->dataPath, SRVC_TAME_STATS_FILE);
+    file = fopen(statsFile, "w");
+    if ( file == NULL )
+        return;
+
+    fprintf(file, "[Service]\nRounds=%u\nTamed=%u\nProtected=%d\nFirstSweepMs=%llu\nFirstSweepThreads=%d\n\n", gTamer.round, gTamer.tamed,
+            gTamer.protectedMode, (unsigned long long) gTamer.firstSweepMs, gTamer.firstSweepThreads);
+
+    /* Spawn to tame latency of processes tamed while the service was already running, in milliseconds */
+    fprintf(file, "[Latency]\nCount=%llu\nAverageMs=%llu\nMaxMs=%llu\n\n", (unsigned long long) gTamer.latencyCount,
+            (unsigned long long) (gTamer.latencyCount ? gTamer.latencySum / gTamer.latencyCount / 10000 : 0), (unsigned long long) (gTamer.latencyMax / 10000));
+
+    fprintf(file, "[HandleCache]\nCapacity=%d\nCount=%d\nHits=%llu\nMisses=%llu\nEvictions=%llu\nStale=%llu\n\n", gTamer.handleCache.capacity,
+            gTamer.handleCache.count, (unsigned long long) gTamer.handleCache.hits, (unsigned long long) gTamer.handleCache.misses,
+            (unsigned long long) gTamer.handleCache.evictions, (unsigned long long) gTamer.handleCache.stale);
+
+    QueryPerformanceFrequency(&frequency);
+    fprintf(file, "[Inversion]\nInspected=%llu\nLifts=%llu\nThaws=%llu\nTimeMs=%llu\n\n", (unsigned long long) gTamer.inversion.inspected,
+            (unsigned long long) gTamer.inversion.lifts, (unsigned long long) gTamer.inversion.thaws,
+            (unsigned long long) (gTamer.inversion.ticks * 1000 / frequency.QuadPart));
+
+    fprintf(file, "[Memory]\nTrims=%llu\n\n", (unsigned long long) gTamer.trims);
+
+    if ( gTamer.energy.totalMs != 0 )
+        Tamer_StatsEnergy(file);
+
+    if ( gTamer.wake.wakes != 0 )
+        fprintf(file, "[Coalesce]\nWakes=%llu\nThrottled=%llu\nEvents=%llu\nExits=%llu\nMaxBatch=%llu\nWindowMs=%u\n\n",
+                (unsigned long long) gTamer.wake.wakes, (unsigned long long) gTamer.wake.throttled, (unsigned long long) gTamer.wake.events,
+                (unsigned long long) gTamer.wake.exits, (unsigned long long) gTamer.wake.maxBatch, gTamer.wake.window);
+
+    if ( gTamer.slice.hJob != NULL )
+    {
+        JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+
+        memset(&accounting, 0, sizeof(accounting));
+        QueryInformationJobObject(gTamer.slice.hJob, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL);
+        fprintf(file, "[Slice]\nName=%s\nCpuWeight=%u\nMemoryHighMB=%u\nActive=%lu\nAssigned=%llu\nFailed=%llu\n\n", gTamer.slice.name,
+                gTamer.config->sliceCpuWeight, gTamer.config->sliceMemoryHigh, accounting.ActiveProcesses, (unsigned long long) gTamer.slice.assigned,
+                (unsigned long long) gTamer.slice.failed);
+    }
+
+    if ( gTamer.config->threadRules )
+        fprintf(file, "[Threads]\nNameLookups=%llu\nTamed=%llu\n\n", (unsigned long long) gTamer.threads.lookups, (unsigned long long) gTamer.threads.tamed);
+
+    if ( gTamer.config->housekeeping != 0 )
+        Tamer_StatsFrequency(file);
+
+    if ( gTamer.jobs.hPort != NULL )
+        EnterCriticalSection(&gTamer.jobs.lock);
+
+    LL_FOREACH(gTamer.jobs.list, job)
+    {
+        JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+
+        memset(&accounting, 0, sizeof(accounting));
+        QueryInformationJobObject(job->hJob, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL);
+        fprintf(file, "[Job.Process%d]\nName=%s\nMaxProcesses=%u\nActive=%lu\nSpawned=%llu\nLimitHits=%llu\nFull=%llu\n", job->index, job->name,
+                job->maxProcesses, accounting.ActiveProcesses, (unsigned long long) job->spawned, (unsigned long long) job->limitHits,
+                (unsigned long long) job->full);
+        fprintf(file, "Exits=%llu\nShortLived=%llu\nShortLivedCpuMs=%llu\nExitedCpuMs=%llu\nExitedIoKB=%llu\n", (unsigned long long) job->exits,
+                (unsigned long long) job->shortLived, (unsigned long long) (job->shortCpu / 10000), (unsigned long long) (job->exitCpu / 10000),
+                (unsigned long long) (job->exitIo / 1024));
+        fprintf(file, "CpuMs=%llu\nIoKB=%llu\nCpuRate=%u\nIoRateKBs=%llu\nPeakMemoryKB=%llu\nHog=%d\nHogChecks=%llu\n",
+                (unsigned long long) (job->cpuTime / 10000), (unsigned long long) (job->ioBytes / 1024), job->cpuRate, (unsigned long long) job->ioRate,
+                (unsigned long long) (job->peakMemory / 1024), job->hog, (unsigned long long) job->hogChecks);
+        fprintf(file, "CpuTarget=%u\nCpuCap=%.2f\nEnergyJ=%llu\n\n", job->cpuTarget, job->cpuTarget ? job->cpuCap : 100.0,
+                (unsigned long long) (job->energy / 1000000));
+    }
+
+    if ( gTamer.jobs.hPort != NULL )
+        LeaveCriticalSection(&gTamer.jobs.lock);
+
+    if ( gTamer.limiter.initialized )
+    {
+        Tamer_LimitGroup *group;
+
+        EnterCriticalSection(&gTamer.limiter.lock);
+        LL_FOREACH(gTamer.limiter.groups, group)
+        {
+            if ( group->serialize )
+            {
+                fprintf(file, "[Serialize.%s]\nRunning=%u\nQueued=%u\nRotations=%llu\nContendedMs=%llu\nMaxWaitMs=%llu\n\n", group->name, group->running,
+                        group->queued, (unsigned long long) group->rotations, (unsigned long long) group->contended, (unsigned long long) group->maxWait);
+                continue;
+            }
+
+            fprintf(file, "[Limit.Process%d]\nName=%s\nMax=%u\nRunning=%u\nQueued=%u\nFrozen=%llu\nThawed=%llu\nMaxWaitMs=%llu\n\n", group->index, group->name,
+                    group->max, group->running, group->queued, (unsigned long long) group->frozen, (unsigned long long) group->thawed,
+                    (unsigned long long) group->maxWait);
+        }
+        LeaveCriticalSection(&gTamer.limiter.lock);
+    }
+
+    for ( int i = 0; i < gTamer.pluginCount; i++ )
+    {
+        Tamer_Plugin *plugin = &gTamer.plugins[i];
+
+        fprintf(file, "[Plugin.%s]\nCalls=%llu\nProcesses=%llu\nMatches=%llu\nTotalMs=%llu\nMaxMs=%llu\nDisabled=%d\n\n", plugin->api.name,
+                (unsigned long long) plugin->calls, (unsigned long long) plugin->processes, (unsigned long long) plugin->matches,
+                (unsigned long long) (plugin->ticks * 1000 / frequency.QuadPart),
+                (unsigned long long) (plugin->maxTicks * 1000 / frequency.QuadPart), plugin->disabled);
+    }
+
+    if ( gTamer.state.header != NULL )
+        fprintf(file, "[State]\nCount=%u\nResumed=%u\nRestored=%u\nThawed=%u\nPidPages=%u\nIdentities=%u\nIdentityHits=%llu\n\n",
+                gTamer.state.header->count, gTamer.state.resumed, gTamer.state.restored, gTamer.state.thawed, gTamer.pids.allocated,
+                gTamer.pids.identityCount, (unsigned long long) gTamer.pids.identityHits);
+
+    fclose(file);
+}
+
+/**
+ * @brief Case insensitive wildcard match, '*' matches any run of characters and '?' any one.
+ * @param pattern Pattern.
+ * @param text Text to match.
+ * @return true if the whole text matches.
+ */
+
+static bool Tamer_WildMatch(const char *pattern, const char *text)
+{
+    const char *star = NULL, *resume = NULL;
+
+    while ( *text )
+    {
+        if ( *pattern == '*' )
+        {
+            star   = ++pattern;
+            resume = text;
+        }
+        else if ( *pattern == '?' || tolower((unsigned char) *pattern) == tolower((unsigned char) *text) )
+        {
+            pattern++;
+            text++;
+        }
+        else if ( star != NULL )
+        {
+            pattern = star;
+            text    = ++resume;
+        }
+        else
+            return false;
+    }
+
+    while ( *pattern == '*' )
+        pattern++;
+
+    return *pattern == 0;
+}
+
+/**
+ * @brief Queue a process whose threads are to be tamed by name at the end of the sweep.
+ * @param pid Process ID.
+ * @param action Pointer to the composite action of the process.
+ */
+
+static void Tamer_ThreadQueue(DWORD pid, const Tamer_Action *action)
+{
+    Tamer_ThreadTarget *grown;
+
+    if ( gTamer.threads.targetCount == gTamer.threads.targetSize )
+    {
+        int size = gTamer.threads.targetSize ? gTamer.threads.targetSize * 2 : 16;
+
+        grown = (Tamer_ThreadTarget *) realloc(gTamer.threads.targets, size * sizeof(Tamer_ThreadTarget));
+        if ( grown == NULL )
+            return;
+
+        gTamer.threads.targets    = grown;
+        gTamer.threads.targetSize = size;
+    }
+
+    gTamer.threads.targets[gTamer.threads.targetCount].pid      = pid;
+    gTamer.threads.targets[gTamer.threads.targetCount].priority = action->threadPriority;
+    gTamer.threads.targets[gTamer.threads.targetCount].pattern  = action->threadPattern;
+    gTamer.threads.targetCount++;
+}
+
+/**
+ * @brief Get a cached thread, reading its name when it is seen for the first time.
+ * @param tid Thread ID.
+ * @param pid Owner process ID.
+ * @retval Tamer_ThreadEntry* Pointer to the entry, NULL on error.
+ */
+
+static Tamer_ThreadEntry *Tamer_ThreadLookup(DWORD tid, DWORD pid)
+{
+    Tamer_ThreadEntry **bucket = &gTamer.threads.buckets[(tid >> 2) & (SRVC_TAME_THREAD_BUCKETS - 1)];
+    Tamer_ThreadEntry  *entry;
+    HANDLE              hThread;
+    PWSTR               description = NULL;
+
+    LL_FOREACH(*bucket, entry)
+    {
+        if ( entry->tid == tid && entry->pid == pid )
+            return entry;
+    }
+
+    entry = (Tamer_ThreadEntry *) malloc(sizeof(Tamer_ThreadEntry));
+    if ( entry == NULL )
+        return NULL;
+
+    memset(entry, 0, sizeof(Tamer_ThreadEntry));
+    entry->tid = tid;
+    entry->pid = pid;
+
+    /* A new thread: this is the only time its name is read */
+    gTamer.threads.lookups++;
+    hThread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, tid);
+    if ( hThread != NULL )
+    {
+        if ( gTamer.nt.GetThreadDescription != NULL && SUCCEEDED(gTamer.nt.GetThreadDescription(hThread, &description)) && description != NULL )
+        {
+            WideCharToMultiByte(CP_UTF8, 0, description, -1, entry->name, sizeof(entry->name), NULL, NULL);
+            entry->name[sizeof(entry->name) - 1] = 0;
+            LocalFree(description);
+        }
+
+        CloseHandle(hThread);
+    }
+
+    LL_PREPEND(*bucket, entry);
+    return entry;
+}
+
+/**
+ * @brief Set or restore the priority of a single thread.
+ * @param entry Pointer to the cached thread.
+ * @param priority Thread priority to set, ignored when restoring.
+ * @param restore true to give the thread back its original priority.
+ */
+
+static void Tamer_ThreadSetPriority(Tamer_ThreadEntry *entry, int priority, bool restore)
+{
+    HANDLE hThread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION | THREAD_SET_LIMITED_INFORMATION, FALSE, entry->tid);
+    int    current;
+
+    if ( hThread == NULL )
+        return;
+
+    current = GetThreadPriority(hThread);
+    if ( restore )
+    {
+        if ( entry->applied )
+            SetThreadPriority(hThread, entry->priority);
+        entry->applied = false;
+    }
+    else if ( current != priority )
+    {
+        if ( entry->applied == false )
+            entry->priority = current;
+
+        if ( SetThreadPriority(hThread, priority) )
+        {
+            entry->applied = true;
+            gTamer.threads.tamed++;
+        }
+    }
+
+    CloseHandle(hThread);
+}
+
+/**
+ * @brief Give the threads of a lifted process back their original priorities.
+ * The process is not queued by this sweep, so the end of the sweep forgets them.
+ * @param pid Process ID.
+ */
+
+static void Tamer_ThreadsLift(DWORD pid)
+{
+    Tamer_ThreadEntry *entry;
+
+    for ( int i = 0; i < SRVC_TAME_THREAD_BUCKETS; i++ )
+    {
+        LL_FOREACH(gTamer.threads.buckets[i], entry)
+        {
+            if ( entry->pid == pid && entry->applied )
+                Tamer_ThreadSetPriority(entry, 0, true);
+        }
+    }
+}
+
+/**
+ * @brief Tame the threads queued by the sweep whose name matches their entry pattern.
+ * Thread names come from the cache, only threads created since the previous sweep are
+ * looked up. Cached threads no longer seen in a targeted process are restored and dropped.
+ * @param hSnapShot Snapshot of this sweep, including threads.
+ */
+
+static void Tamer_ThreadsApply(HANDLE hSnapShot)
+{
+    THREADENTRY32      tEntry;
+    BOOL               hRes;
+    Tamer_ThreadEntry *entry, *tmp;
+
+    if ( gTamer.threads.targetCount > 0 )
+    {
+        tEntry.dwSize = sizeof(tEntry);
+        hRes          = Thread32First(hSnapShot, &tEntry);
+
+        while ( hRes )
+        {
+            for ( int i = 0; i < gTamer.threads.targetCount; i++ )
+            {
+                Tamer_ThreadTarget *target = &gTamer.threads.targets[i];
+
+                if ( target->pid != tEntry.th32OwnerProcessID )
+                    continue;
+
+                entry = Tamer_ThreadLookup(tEntry.th32ThreadID, tEntry.th32OwnerProcessID);
+                if ( entry != NULL )
+                {
+                    entry->round = gTamer.round;
+                    if ( entry->name[0] != 0 && Tamer_WildMatch(target->pattern, entry->name) )
+                        Tamer_ThreadSetPriority(entry, target->priority, false);
+                    else if ( entry->applied )
+                        Tamer_ThreadSetPriority(entry, 0, true); /* The entry pattern changed */
+                }
+                break;
+            }
+
+            hRes = Thread32Next(hSnapShot, &tEntry);
+        }
+    }
+
+    for ( int i = 0; i < SRVC_TAME_THREAD_BUCKETS; i++ )
+    {
+        LL_FOREACH_SAFE(gTamer.threads.buckets[i], entry, tmp)
+        {
+            if ( entry->round == gTamer.round )
+                continue;
+
+            /* Either the thread exited, or its process is no longer targeted */
+            if ( entry->applied )
+                Tamer_ThreadSetPriority(entry, 0, true);
+
+            LL_DELETE(gTamer.threads.buckets[i], entry);
+            free(entry);
+        }
+    }
+
+    gTamer.threads.targetCount = 0;
+}
+
+/**
+ * @brief Temporarily lift a tamed process that a protected thread is waiting on.
+ * Priority, thread priorities, placement and throttling are all given back and a process frozen by its instances limit or its serialize
+ * group is thawed. The lift lasts for the current sweep only, the next sweep tames the process again unless the wait is still there.
+ * @param pid ID of the process to lift.
+ */
+
+static void Tamer_InversionLift(DWORD pid)
+{
+    Tamer_StateEntry *entry = Tamer_StateLookup(pid);
+    HANDLE            hProcess;
+
+    Tamer_LimitLift(pid);
+
+    if ( entry == NULL || entry->lifted == gTamer.round )
+        return;
+
+    hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_SET_INFORMATION, FALSE, pid);
+    if ( hProcess == NULL )
+        return;
+
+    if ( Tamer_GetStartTime(hProcess) == entry->startTime )
+    {
+        if ( entry->lifted != gTamer.round - 1 )
+            gTamer.inversion.lifts++;
+
+        Tamer_StateRestore(hProcess, entry);
+        Tamer_ThreadsLift(pid);
+        entry->lifted = gTamer.round;
+    }
+
+    CloseHandle(hProcess);
+}
+
+/**
+ * @brief Relieve priority inversions between protected and tamed processes.
+ * The wait chains of threads belonging to protected processes (the foreground one and the
+ * [Protected] list) are walked; any tamed process found owning what such a thread waits
+ * on (ALPC port, mutex, COM call, SendMessage, ...) is lifted for this sweep. At most
+ * 'InversionThreads' chains are retrieved per sweep, round robin over the protected threads.
+ * @param hSnapShot Process and thread snapshot of this sweep.
+ */
+
+static void Tamer_InversionRelief(HANDLE hSnapShot)
+{
+    DWORD               protectedPids[SRVC_TAME_PROTECTED_MAX + 1];
+    int                 protectedCount = 0;
+    uint32_t            threadIndex = 0, budget = gTamer.config->inversionThreads;
+    PROCESSENTRY32      pEntry;
+    THREADENTRY32       tEntry;
+    WAITCHAIN_NODE_INFO nodes[WCT_MAX_NODE_COUNT];
+    DWORD               nodeCount;
+    BOOL                isCycle, hRes;
+    LARGE_INTEGER       start, end;
+    HWND                hForeground;
+
+    if ( budget == 0 || gTamer.state.header == NULL || gTamer.state.header->count == 0 )
+        return;
+
+    QueryPerformanceCounter(&start);
+
+    if ( gTamer.inversion.hWct == NULL )
+    {
+        gTamer.inversion.hWct = OpenThreadWaitChainSession(0, NULL);
+        if ( gTamer.inversion.hWct == NULL )
+            return;
+    }
+
+    /* There is no foreground window when running as a service in session 0 */
+    hForeground = GetForegroundWindow();
+    if ( hForeground != NULL && GetWindowThreadProcessId(hForeground, &protectedPids[protectedCount]) != 0 )
+        protectedCount++;
+
+    pEntry.dwSize = sizeof(pEntry);
+    hRes          = Process32First(hSnapShot, &pEntry);
+    while ( hRes && protectedCount < SRVC_TAME_PROTECTED_MAX + 1 )
+    {
+        for ( int i = 0; i < gTamer.config->protectedCount; i++ )
+        {
+            if ( _stricmp(pEntry.szExeFile, gTamer.config->protectedNames[i]) == 0 )
+            {
+                protectedPids[protectedCount++] = pEntry.th32ProcessID;
+                break;
+            }
+        }
+
+        hRes = Process32Next(hSnapShot, &pEntry);
+    }
+
+    tEntry.dwSize = sizeof(tEntry);
+    hRes          = Thread32First(hSnapShot, &tEntry);
+    while ( hRes && budget > 0 && protectedCount > 0 )
+    {
+        for ( int i = 0; i < protectedCount; i++ )
+        {
+            if ( tEntry.th32OwnerProcessID != protectedPids[i] )
+                continue;
+
+            if ( threadIndex++ < gTamer.inversion.cursor )
+                break;
+
+            budget--;
+            gTamer.inversion.inspected++;
+            nodeCount = WCT_MAX_NODE_COUNT;
+            if ( GetThreadWaitChain(gTamer.inversion.hWct, 0, WCTP_GETINFO_ALL_FLAGS, tEntry.th32ThreadID, &nodeCount, nodes, &isCycle) )
+            {
+                /* The first node is the protected thread itself */
+                for ( DWORD n = 1; n < nodeCount && n < WCT_MAX_NODE_COUNT; n++ )
+                {
+                    if ( nodes[n].ObjectType == WctThreadType && nodes[n].ThreadObject.ProcessId != tEntry.th32OwnerProcessID )
+                        Tamer_InversionLift(nodes[n].ThreadObject.ProcessId);
+                }
+            }
+            break;
+        }
+
+        hRes = Thread32Next(hSnapShot, &tEntry);
+    }
+
+    /* Carry on from here next sweep, or start over once every protected thread was visited */
+    gTamer.inversion.cursor = (budget == 0) ? threadIndex : 0;
+
+    QueryPerformanceCounter(&end);
+    gTamer.inversion.ticks += end.QuadPart - start.QuadPart;
+}
+
+/**
+ * @brief Queue a process to move into the background job object at the end of the sweep.
+ * @param pid Process ID.
+ */
+
+static void Tamer_SliceQueue(DWORD pid)
+{
+    DWORD *grown;
+
+    if ( gTamer.slice.queued == gTamer.slice.queueSize )
+    {
+        int size = gTamer.slice.queueSize ? gTamer.slice.queueSize * 2 : 64;
+
+        grown = (DWORD *) realloc(gTamer.slice.queue, size * sizeof(DWORD));
+        if ( grown == NULL )
+            return;
+
+        gTamer.slice.queue     = grown;
+        gTamer.slice.queueSize = size;
+    }
+
+    gTamer.slice.queue[gTamer.slice.queued++] = pid;
+}
+
+/**
+ * @brief Move the queued processes into the background job object, in one batch.
+ * The job is named, so it outlives a service restart and other tools can find it. It is
+ * created, or opened, and given its properties once, not once per process.
+ */
+
+static void Tamer_SliceFlush(void)
+{
+    char              jobName[sizeof(gTamer.slice.name) + 8];
+    Tamer_StateEntry *entry;
+    HANDLE            hProcess;
+    BOOL              inJob;
+
+    if ( gTamer.slice.queued == 0 )
+        return;
+
+    if ( gTamer.slice.hJob == NULL )
+    {
+        snprintf(gTamer.slice.name, sizeof(gTamer.slice.name), "%s", gTamer.config->sliceName);
+        snprintf(jobName, sizeof(jobName), "Global\\%s", gTamer.slice.name);
+
+        gTamer.slice.hJob = CreateJobObject(NULL, jobName);
+        if ( gTamer.slice.hJob == NULL )
+        {
+            gTamer.slice.failed += gTamer.slice.queued;
+            gTamer.slice.queued = 0;
+            return;
+        }
+
+        Tamer_SliceConfigure(true);
+    }
+
+    for ( int i = 0; i < gTamer.slice.queued; i++ )
+    {
+        hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_SET_QUOTA | PROCESS_TERMINATE, FALSE, gTamer.slice.queue[i]);
+        if ( hProcess == NULL )
+            continue;
+
+        if ( IsProcessInJob(hProcess, gTamer.slice.hJob, &inJob) && (inJob || AssignProcessToJobObject(gTamer.slice.hJob, hProcess)) )
+        {
+            if ( inJob == FALSE )
+                gTamer.slice.assigned++;
+
+            entry = Tamer_StateLookup(gTamer.slice.queue[i]);
+            if ( entry != NULL )
+                entry->applied |= TAMER_ACTION_SLICE;
+        }
+        else
+            gTamer.slice.failed++;
+
+        CloseHandle(hProcess);
+    }
+
+    gTamer.slice.queued = 0;
+}
+
+/**
+ * @brief Apply a composite action to a process.
+ * @param pid ID of the process to tame.
+ * @param action Pointer to the composite action.
+ */
+
+static void Tamer_ApplyAction(DWORD pid, const Tamer_Action *action)
+{
+    bool              cached, known, sampled = false;
+    uint64_t          startTime = 0, cpuDelta = 0;
+    DWORD             priorityClass;
+    Tamer_StateEntry *entry;
+    HANDLE            hProcess = Tamer_HandleOpen(pid, &startTime, &cached);
+
+    if ( hProcess == NULL )
+        return;
+
+    /* Track the process, its original settings are recorded the first time it is tamed */
+    priorityClass = GetPriorityClass(hProcess);
+    entry         = Tamer_StateLookup(pid);
+    known         = (entry != NULL && entry->pid == pid && entry->startTime == startTime);
+    entry         = Tamer_StateTrack(pid, startTime, priorityClass);
+
+    /* Only processes started since the previous sweep have a latency, older ones simply had no record */
+    if ( known == false && gTamer.round > 1 && startTime > gTamer.previousSweep )
+        Tamer_TameLatency(startTime);
+
+    /* Processor time since the previous sweep: tells the idle processes to trim, and the energy share of the tamed ones */
+    if ( entry != NULL )
+    {
+        sampled = Tamer_StateCpu(hProcess, entry, &cpuDelta);
+        if ( sampled )
+            gTamer.energy.tamedCpu += cpuDelta;
+    }
+
+    /* A lifted process keeps its original priority until the protected thread stops waiting on it */
+    if ( (action->fields & TAMER_ACTION_PRIORITY) && (entry == NULL || entry->lifted != gTamer.round) )
+    {
+        if ( priorityClass != action->priorityClass && SetPriorityClass(hProcess, action->priorityClass) )
+        {
+            /* Something brought a process we already tamed back up, unless it was our own lift */
+            if ( known && entry != NULL && entry->lifted != gTamer.round - 1 )
+                entry->level++;
+        }
+    }
+
+    if ( (action->fields & TAMER_ACTION_THREADS) && (entry == NULL || entry->lifted != gTamer.round) )
+        Tamer_ThreadQueue(pid, action);
+
+    if ( action->fields & TAMER_ACTION_LIMIT )
+        Tamer_LimitTrack(pid, action->limitRule, false);
+
+    if ( action->fields & TAMER_ACTION_SERIALIZE )
+        Tamer_LimitTrack(pid, action->serializeRule, true);
+
+    if ( action->fields & TAMER_ACTION_JOB )
+        Tamer_JobAssign(hProcess, pid, action->jobRule);
+
+    /* A process in an entry job could not join the slice anyway */
+    if ( (action->fields & TAMER_ACTION_SLICE) && (action->fields & TAMER_ACTION_JOB) == 0 && (entry == NULL || (entry->applied & TAMER_ACTION_SLICE) == 0) )
+        Tamer_SliceQueue(pid);
+
+    /* Settings applied for a previous configuration that the current action no longer asks for */
+    if ( entry != NULL && entry->lifted != gTamer.round )
+        Tamer_StateRevert(hProcess, entry, entry->applied & ~action->fields);
+
+    /* Placement and throttling go together, also without a record (table unavailable or full) whose original values are then lost */
+    if ( entry == NULL || entry->lifted != gTamer.round )
+    {
+        if ( action->fields & TAMER_ACTION_AFFINITY )
+        {
+            DWORD_PTR processMask, systemMask;
+
+            if ( GetProcessAffinityMask(hProcess, &processMask, &systemMask) && processMask != (action->affinity & systemMask) )
+            {
+                if ( entry != NULL && (entry->applied & TAMER_ACTION_AFFINITY) == 0 )
+                    entry->affinity = processMask;
+
+                if ( (action->affinity & systemMask) != 0 && SetProcessAffinityMask(hProcess, action->affinity & systemMask) && entry != NULL )
+                    entry->applied |= TAMER_ACTION_AFFINITY;
+            }
+        }
+
+        if ( (action->fields & TAMER_ACTION_ECOQOS) && (entry == NULL || (entry->applied & TAMER_ACTION_ECOQOS) == 0) &&
+             Tamer_SetEcoQoS(hProcess, action->ecoQoS) && entry != NULL )
+            entry->applied |= TAMER_ACTION_ECOQOS;
+
+        /* I/O is part of the same batch, checked every sweep since nothing stops the process from raising it back */
+        if ( action->fields & TAMER_ACTION_IOPRIO )
+        {
+            ULONG ioPriority = TAMER_IO_PRIORITY_NORMAL;
+
+            if ( Tamer_GetIoPriority(hProcess, &ioPriority) == false || ioPriority != action->ioPriority )
+            {
+                if ( entry != NULL && (entry->applied & TAMER_ACTION_IOPRIO) == 0 )
+                    entry->ioPriority = ioPriority;
+
+                if ( Tamer_SetIoPriority(hProcess, action->ioPriority) && entry != NULL )
+                    entry->applied |= TAMER_ACTION_IOPRIO;
+            }
+        }
+
+        /* Low memory priority pages are repurposed first, the cold memory of tamed processes goes before anything else */
+        if ( action->fields & TAMER_ACTION_MEMPRIO )
+        {
+            ULONG memoryPriority = MEMORY_PRIORITY_NORMAL;
+
+            if ( Tamer_GetMemoryPriority(hProcess, &memoryPriority) == false || memoryPriority != action->memoryPriority )
+            {
+                if ( entry != NULL && (entry->applied & TAMER_ACTION_MEMPRIO) == 0 )
+                    entry->memoryPriority = memoryPriority;
+
+                if ( Tamer_SetMemoryPriority(hProcess, action->memoryPriority) && entry != NULL )
+                    entry->applied |= TAMER_ACTION_MEMPRIO;
+            }
+        }
+
+        /* Idleness is told from the processor time kept in the record */
+        if ( (action->fields & TAMER_ACTION_TRIM) && entry != NULL )
+            Tamer_TrimIdle(hProcess, entry, sampled, cpuDelta);
+    }
+
+    Tamer_HandleClose(hProcess, cached);
+}
+
+/**
+ * @brief Name the configuration setting behind each action field, for the console.
+ * @param fields Action fields, TAMER_ACTION_xxx.
+ * @param text Output text.
+ * @param size Size of the output text.
+ * @return The output text.
+ */
+
+static const char *Tamer_LintFields(uint32_t fields, char *text, size_t size)
+{
+    static const struct
+    {
+        uint32_t    field;
+        const char *name;
+    } names[] = {
+        {TAMER_ACTION_PRIORITY, "Prio"},
+        {TAMER_ACTION_AFFINITY, "Cpus"},
+        {TAMER_ACTION_ECOQOS, "EcoQoS"},
+        {TAMER_ACTION_IOPRIO, "IoPrio"},
+        {TAMER_ACTION_PLUGIN, "Plugin"},
+        {TAMER_ACTION_THREADS, "Threads"},
+        {TAMER_ACTION_LIMIT, "MaxInstances"},
+        {TAMER_ACTION_SERIALIZE, "Serialize"},
+        {TAMER_ACTION_JOB, "Job"},
+        {TAMER_ACTION_MEMPRIO, "MemPrio"},
+        {TAMER_ACTION_TRIM, "Trim"},
+        {TAMER_ACTION_SLICE, "Slice"},
+    };
+    size_t used = 0;
+
+    text[0] = 0;
+    for ( size_t i = 0; i < sizeof(names) / sizeof(names[0]) && used < size; i++ )
+    {
+        if ( fields & names[i].field )
+            used += snprintf(text + used, size - used, "%s%s", used ? "," : "", names[i].name);
+    }
+
+    return text;
+}
+
+/**
+ * @brief Print what a dry run would do to a process, against its current settings.
+ * The decision is made again at every sweep, and printed whenever it differs from the last
+ * one printed: settings drifting back, or a changed action, show up as they happen.
+ * The state table is a private copy in a dry run, it records what was already printed.
+ * @param pEntry Pointer to the snapshot entry of the process.
+ * @param action Pointer to its composite action.
+ */
+
+static void Tamer_DryRunReport(PROCESSENTRY32 *pEntry, const Tamer_Action *action)
+{
+    Tamer_StateEntry *entry;
+    HANDLE            hProcess;
+    DWORD             priorityClass;
+    DWORD_PTR         processMask, systemMask;
+    ULONG             value;
+    uint64_t          startTime = 0;
+    uint32_t          other, digest;
+    bool              cached, tracked;
+    char              diff[512], fields[128];
+    int               used = 0;
+
+    hProcess = Tamer_HandleOpen(pEntry->th32ProcessID, &startTime, &cached);
+    if ( hProcess == NULL )
+    {
+        /* Still matching, it must not be reported as given back at the end of the sweep */
+        entry = Tamer_StateLookup(pEntry->th32ProcessID);
+        if ( entry != NULL )
+            entry->round = gTamer.round;
+        return;
+    }
+
+    do
+    {
+        priorityClass = GetPriorityClass(hProcess);
+        entry         = Tamer_StateLookup(pEntry->th32ProcessID);
+        tracked       = (entry != NULL && entry->pid == pEntry->th32ProcessID && entry->startTime == startTime);
+
+        if ( (action->fields & TAMER_ACTION_PRIORITY) && priorityClass != action->priorityClass )
+            used += snprintf(diff + used, sizeof(diff) - used, " Prio=0x%lx>0x%lx", priorityClass, action->priorityClass);
+
+        if ( (action->fields & TAMER_ACTION_AFFINITY) && GetProcessAffinityMask(hProcess, &processMask, &systemMask) &&
+             processMask != (action->affinity & systemMask) )
+            used += snprintf(diff + used, sizeof(diff) - used, " Cpus=%llx>%llx", (unsigned long long) processMask,
+                             (unsigned long long) (action->affinity & systemMask));
+
+        value = TAMER_IO_PRIORITY_NORMAL;
+        if ( (action->fields & TAMER_ACTION_IOPRIO) && (Tamer_GetIoPriority(hProcess, &value) == false || value != action->ioPriority) )
+            used += snprintf(diff + used, sizeof(diff) - used, " IoPrio=%lu>%lu", value, action->ioPriority);
+
+        value = MEMORY_PRIORITY_NORMAL;
+        if ( (action->fields & TAMER_ACTION_MEMPRIO) && (Tamer_GetMemoryPriority(hProcess, &value) == false || value != action->memoryPriority) )
+            used += snprintf(diff + used, sizeof(diff) - used, " MemPrio=%lu>%lu", value, action->memoryPriority);
+
+        /* Power throttling cannot be read back, the remaining actions have no per process setting to compare */
+        if ( (action->fields & TAMER_ACTION_ECOQOS) && (tracked == false || (entry->applied & TAMER_ACTION_ECOQOS) == 0) )
+            used += snprintf(diff + used, sizeof(diff) - used, " EcoQoS");
+
+        other = action->fields & ~(TAMER_ACTION_PRIORITY | TAMER_ACTION_AFFINITY | TAMER_ACTION_IOPRIO | TAMER_ACTION_MEMPRIO | TAMER_ACTION_ECOQOS);
+        if ( other != 0 )
+            used += snprintf(diff + used, sizeof(diff) - used, " %s", Tamer_LintFields(other, fields, sizeof(fields)));
+
+        if ( used != 0 )
+            gTamer.dryRunChanges++;
+
+        /* Never 0, which stands for a process not printed yet */
+        digest = used ? Tamer_CRC2((const uint8_t *) diff, (size_t) used) | 1 : 1;
+        if ( tracked )
+        {
+            entry->round = gTamer.round;
+            if ( entry->reported == digest )
+                break; /* Printed as is already */
+        }
+
+        /* '~' for a process whose decision changed since it was printed */
+        printf("%c %lu %s:%s\n", tracked ? (entry->reported != 0 ? '~' : '=') : '+', pEntry->th32ProcessID, pEntry->szExeFile,
+               used ? diff : " unchanged");
+
+        if ( tracked == false )
+            entry = Tamer_StateTrack(pEntry->th32ProcessID, startTime, priorityClass);
+
+        if ( entry != NULL )
+            entry->reported = digest;
+
+    } while ( 0 );
+
+    Tamer_HandleClose(hProcess, cached);
+}
+
+/**
+ * @brief Act upon a process once its action is decided.
+ * @param pEntry Pointer to the snapshot entry of the process.
+ * @param action Pointer to its composite action.
+ */
+
+static void Tamer_SweepApply(PROCESSENTRY32 *pEntry, const Tamer_Action *action)
+{
+    Tamer_StateEntry *entry;
+
+    if ( action->fields == 0 )
+        return;
+
+    gTamer.tamed++;
+    if ( gTamer.dryRun )
+    {
+        Tamer_DryRunReport(pEntry, action);
+        return;
+    }
+
+    /* Still matching, even if the process cannot be opened this time its record must survive the sweep */
+    entry = Tamer_StateLookup(pEntry->th32ProcessID);
+    if ( entry != NULL )
+        entry->round = gTamer.round;
+
+    Tamer_ApplyAction(pEntry->th32ProcessID, action);
+    if ( action->fields & TAMER_ACTION_PLUGIN )
+        Tamer_PluginQueue(pEntry, action);
+}
+
+/**
+ * @brief Order snapshot entries by PID.
+ * @param a Pointer to the first entry.
+ * @param b Pointer to the second entry.
+ * @return Negative, zero or positive as for qsort().
+ */
+
+static int Tamer_SweepCompare(const void *a, const void *b)
+{
+    DWORD pidA = ((const PROCESSENTRY32 *) a)->th32ProcessID;
+    DWORD pidB = ((const PROCESSENTRY32 *) b)->th32ProcessID;
+
+    return (pidA > pidB) - (pidA < pidB);
+}
+
+/**
+ * @brief First sweep worker, classifies the processes of one PID range.
+ * @param param Pointer to the shard.
+ * @retval DWORD Always 0.
+ */
+
+static DWORD WINAPI Tamer_SweepWorker(LPVOID param)
+{
+    Tamer_SweepShard *shard = (Tamer_SweepShard *) param;
+
+    for ( size_t i = 0; i < shard->count; i++ )
+        Tamer_MatcherDecide(&gTamer.config->matcher, &shard->entries[i], &shard->idents[i], &shard->actions[i]);
+
+    return 0;
+}
+
+/**
+ * @brief Sharded first sweep: every process on the machine has to be classified at once,
+ * including the path and digest lookups, so classification is split by PID range across
+ * worker threads. Each shard writes its own slice of the decisions, nothing is shared
+ * until the threads are joined. Actions are then applied by this thread, in PID order.
+ * Not used when a plugin match predicate is loaded, those run on the service thread only.
+ * @param hSnapShot Snapshot of this sweep.
+ * @return true if the sweep was done, false to fall back to the single threaded one.
+ */
+
+static bool Tamer_SweepSharded(HANDLE hSnapShot)
+{
+    Tamer_SweepShard    shards[SRVC_TAME_SWEEP_THREADS_MAX];
+    PROCESSENTRY32     *entries = NULL;
+    Tamer_Action       *actions = NULL;
+    Tamer_ProcIdentity *idents  = NULL;
+    size_t              count = 0, size = 1024, perShard;
+    int                 threads = gTamer.config->sweepThreads;
+    bool                retVal  = false;
+    BOOL                hRes;
+    SYSTEM_INFO         sysInfo;
+
+    if ( threads == SRVC_TAME_SWEEP_THREADS_AUTO )
+    {
+        GetSystemInfo(&sysInfo);
+        threads = (int) sysInfo.dwNumberOfProcessors;
+    }
+
+    if ( threads > SRVC_TAME_SWEEP_THREADS_MAX )
+        threads = SRVC_TAME_SWEEP_THREADS_MAX;
+
+    if ( threads <= 1 )
+        return false;
+
+    for ( int i = 0; i < gTamer.pluginCount; i++ )
+    {
+        if ( gTamer.plugins[i].api.match != NULL )
+            return false;
+    }
+
+    memset(shards, 0, sizeof(shards));
+
+    do
+    {
+        /* Walking the snapshot is sequential, classifying what it holds is not */
+        entries = (PROCESSENTRY32 *) malloc(size * sizeof(PROCESSENTRY32));
+        if ( entries == NULL )
+            break;
+
+        entries[0].dwSize = sizeof(PROCESSENTRY32);
+        hRes              = Process32First(hSnapShot, &entries[0]);
+        while ( hRes )
+        {
+            if ( ++count == size )
+            {
+                PROCESSENTRY32 *grown = (PROCESSENTRY32 *) realloc(entries, size * 2 * sizeof(PROCESSENTRY32));
+                if ( grown == NULL )
+                    break;
+
+                entries = grown;
+                size *= 2;
+            }
+
+            entries[count].dwSize = sizeof(PROCESSENTRY32);
+            hRes                  = Process32Next(hSnapShot, &entries[count]);
+        }
+
+        if ( hRes )
+            break; /* Could not hold the whole snapshot */
+
+        actions = (Tamer_Action *) calloc(count ? count : 1, sizeof(Tamer_Action));
+        idents  = (Tamer_ProcIdentity *) calloc(count ? count : 1, sizeof(Tamer_ProcIdentity));
+        if ( actions == NULL || idents == NULL )
+            break;
+
+        qsort(entries, count, sizeof(PROCESSENTRY32), Tamer_SweepCompare);
+
+        if ( (size_t) threads > count / 64 + 1 )
+            threads = (int) (count / 64 + 1); /* Not worth a thread below a few dozen processes */
+
+        perShard = (count + threads - 1) / threads;
+        for ( int i = 0; i < threads; i++ )
+        {
+            size_t first = (size_t) i * perShard;
+
+            shards[i].entries = entries + first;
+            shards[i].actions = actions + first;
+            shards[i].idents  = idents + first;
+            shards[i].count   = first < count ? (count - first < perShard ? count - first : perShard) : 0;
+
+            /* The last shard runs here */
+            if ( i < threads - 1 )
+                shards[i].hThread = CreateThread(NULL, 0, Tamer_SweepWorker, &shards[i], 0, NULL);
+            if ( shards[i].hThread == NULL )
+                Tamer_SweepWorker(&shards[i]);
+        }
+
+        for ( int i = 0; i < threads; i++ )
+        {
+            if ( shards[i].hThread != NULL )
+            {
+                WaitForSingleObject(shards[i].hThread, INFINITE);
+                CloseHandle(shards[i].hThread);
+            }
+        }
+
+        for ( size_t i = 0; i < count; i++ )
+        {
+            Tamer_PidSeen(entries[i].th32ProcessID);
+            Tamer_PidIdentityStore(entries[i].th32ProcessID, &idents[i]);
+            Tamer_SweepApply(&entries[i], &actions[i]);
+        }
+
+        gTamer.firstSweepThreads = threads;
+        retVal                   = true;
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    if ( entries != NULL )
+        free(entries);
+
+    if ( actions != NULL )
+        free(actions);
+
+    if ( idents != NULL )
+        free(idents);
+
+    return retVal;
+}
+
+/**
+ * @brief Controls the service based on the request code.
+ * @param request Control code for the service.
+ */
+static void Tamer_ServiceControl(DWORD request)
+{
+    /* Intended only when running as a service */
+    if ( gTamer.serviceMode == false )
+        return;
+
+    switch ( request )
+    {
+        case SERVICE_CONTROL_STOP:
+        case SERVICE_CONTROL_SHUTDOWN:
+            /* The service loop thaws and releases what it holds, then reports the service stopped */
+            gTamer.ServiceStatus.dwCurrentState = SERVICE_STOP_PENDING;
+            gTamer.ServiceStatus.dwWaitHint     = SRVC_TAME_STOP_WAIT_HINT;
+            SetServiceStatus(gTamer.hStatus, &gTamer.ServiceStatus);
+            SetEvent(gTamer.hStop);
+            break;
+        default:
+            SetServiceStatus(gTamer.hStatus, &gTamer.ServiceStatus);
+            break;
+    }
+}
+
+/**
+ * @brief Initializes the service settings.
+ * @retval bool true if initialization succeeds, false otherwise.
+ */
+
+static bool Tamer_ServiceInit(void)
+{
+    /* Intended only when running as a service */
+    if ( gTamer.serviceMode == false )
+        return false;
+
+    /* Placeholder */
+    return true;
+}
+
+/**
+ * @brief Main processing loop for the service.
+ * @retval bool true to continue processing, false to indicate a stop condition.
+ */
+
+static bool Tamer_ServiceProcess(void)
+{
+    Tamer_Proc        *el;
+    Tamer_ProcIdentity ident;
+    Tamer_Action       action;
+    HANDLE             hSnapShot;
+    PROCESSENTRY32     pEntry;
+    BOOL               hRes;
+    bool               sharded = false;
+    LARGE_INTEGER      sweepStart, sweepEnd, frequency;
+    FILETIME           now;
+    ULONGLONG          tick;
+
+    /* Update configuration as needed */
+    if ( Tamer_ReadConfig() == 0 )
+        return false;
+
+    if ( gTamer.config == NULL || gTamer.config->procList == NULL )
+        return false;
+
+    /* The hashing thread and its cache are only brought up when some entry matches by digest */
+    LL_FOREACH(gTamer.config->procList, el)
+    {
+        if ( el->hasHash )
+        {
+            Tamer_HashCacheInit();
+            break;
+        }
+    }
+
+    /* Resume the tamed processes table left by a previous run */
+    Tamer_NtInit();
+    Tamer_StateOpen();
+
+    /* A dry run leaves everything as it is, its own console process included */
+    if ( gTamer.dryRun == false )
+        Tamer_SelfProtect(gTamer.config->selfProtect);
+
+    /* The energy used before anything gets tamed is the reference for the use since then */
+    if ( gTamer.round == 0 && gTamer.energy.baselineMs == 0 && gTamer.dryRun == false && Tamer_EnergyBaseline() == false )
+        return false;
+
+    /* A single snapshot per round, every process is looked up in the compiled matcher */
+    GetSystemTimeAsFileTime(&now);
+    gTamer.previousSweep = gTamer.sweepTime;
+    gTamer.sweepTime     = ((uint64_t) now.dwHighDateTime << 32) | now.dwLowDateTime;
+
+    /* Sweeps run early on process creations, rates are taken over the time actually elapsed */
+    tick             = GetTickCount64();
+    gTamer.sweepGap  = gTamer.sweepTick != 0 ? (uint32_t) (tick - gTamer.sweepTick) : gTamer.config->interval;
+    gTamer.sweepTick = tick;
+
+    hSnapShot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS | ((gTamer.config->inversionThreads || gTamer.config->threadRules) ? TH32CS_SNAPTHREAD : 0), 0);
+    if ( hSnapShot == INVALID_HANDLE_VALUE )
+        return false;
+
+    gTamer.round++;
+    if ( gTamer.dryRun == false )
+    {
+        Tamer_InversionRelief(hSnapShot);
+        Tamer_LimitRefreeze();
+    }
+
+    gTamer.tamed         = 0;
+    gTamer.dryRunChanges = 0;
+
+    /* The first sweep classifies every process on the machine, later ones mostly meet known processes */
+    QueryPerformanceCounter(&sweepStart);
+    if ( gTamer.round == 1 )
+        sharded = Tamer_SweepSharded(hSnapShot);
+
+    pEntry.dwSize = sizeof(pEntry);
+    hRes          = sharded ? FALSE : Process32First(hSnapShot, &pEntry);
+
+    while ( hRes )
+    {
+        memset(&ident, 0, sizeof(ident));
+        Tamer_PidSeen(pEntry.th32ProcessID);
+        Tamer_PidIdentityLoad(pEntry.th32ProcessID, &ident);
+
+        Tamer_MatcherDecide(&gTamer.config->matcher, &pEntry, &ident, &action);
+        Tamer_PidIdentityStore(pEntry.th32ProcessID, &ident);
+        Tamer_SweepApply(&pEntry, &action);
+
+        hRes = Process32Next(hSnapShot, &pEntry);
+    }
+
+    QueryPerformanceCounter(&sweepEnd);
+    QueryPerformanceFrequency(&frequency);
+    if ( gTamer.round == 1 )
+    {
+        gTamer.firstSweepMs = (uint64_t) (sweepEnd.QuadPart - sweepStart.QuadPart) * 1000 / frequency.QuadPart;
+        if ( sharded == false )
+            gTamer.firstSweepThreads = 1;
+    }
+
+    Tamer_ThreadsApply(hSnapShot);
+    CloseHandle(hSnapShot);
+    Tamer_PidIdentitySweep();
+
+    /* A dry run stops at the decisions, only the processes that stopped matching are left to report */
+    if ( gTamer.dryRun )
+    {
+        Tamer_StateSweep();
+        printf("Sweep %u: %u processes matched, %u would change, %.0f us.\n", gTamer.round, gTamer.tamed, gTamer.dryRunChanges,
+               (double) (sweepEnd.QuadPart - sweepStart.QuadPart) * 1000000.0 / (double) frequency.QuadPart);
+        return true;
+    }
+
+    /* Plugin actions run here, once per sweep, on whole batches */
+    Tamer_PluginsFlush();
+    Tamer_SliceFlush();
+
+    /* Persist digests computed since the last round */
+    Tamer_HashCacheSave();
+
+    Tamer_SerializeRotate();
+    Tamer_LimitRelease(false);
+    Tamer_JobsSample();
+    Tamer_EnergySample();
+    Tamer_StateSweep();
+    Tamer_HandleTrim();
+    Tamer_StatsWrite();
+
+    return true;
+}
+
+/**
+ * @brief Describe a configured entry for the console.
+ * @param proc Pointer to the configured entry.
+ * @param text Output text.
+ * @param size Size of the output text.
+ * @return The output text.
+ */
+
+static const char *Tamer_LintLabel(const Tamer_Proc *proc, char *text, size_t size)
+{
+    snprintf(text, size, "Process%d (%s)", proc->index, proc->procName[0] ? proc->procName : (proc->procPath[0] ? proc->procPath : "hash"));
+    return text;
+}
+
+/**
+ * @brief Check whether two entries sharing a row may match the same process.
+ * Different digests, or executable paths none of which is a prefix of the other, never meet.
+ * @param a Pointer to the first entry.
+ * @param b Pointer to the second entry.
+ * @retval bool true if some process may match both.
+ */
+
+static bool Tamer_LintOverlap(const Tamer_Proc *a, const Tamer_Proc *b)
+{
+    size_t length;
+
+    if ( a->hasHash && b->hasHash && memcmp(a->hash, b->hash, SRVC_TAME_SHA256_SIZE) != 0 )
+        return false;
+
+    if ( a->procPath[0] != 0 && b->procPath[0] != 0 )
+    {
+        length = strlen(a->procPath) < strlen(b->procPath) ? strlen(a->procPath) : strlen(b->procPath);
+        if ( _strnicmp(a->procPath, b->procPath, length) != 0 )
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Report the entries that can never act and those overriding each other.
+ * Every row of the compiled matcher is walked the way a sweep would walk it, assuming the
+ * entries without any other condition than the name always match: an entry is unreachable
+ * when, in every row holding it, an exclusion or the entries above already settle everything
+ * it provides. Overlapping entries setting the same action are reported along with the winner.
+ * @param matcher Pointer to the compiled matcher.
+ * @return Number of problems found, conflicts excluded.
+ */
+
+static int Tamer_LintRules(Tamer_Matcher *matcher)
+{
+    Tamer_NameSlot *slot;
+    Tamer_Proc     *proc, *other;
+    bool           *live = NULL, *reported = NULL;
+    bool            excluded, unconditional, crossed;
+    uint32_t        covered, shared;
+    char            label[MAX_PATH + 32], otherLabel[MAX_PATH + 32], fields[128];
+    int             problems = 0, conflicts = 0;
+
+    do
+    {
+        live     = (bool *) calloc(matcher->ruleCount, sizeof(bool));
+        reported = (bool *) calloc((size_t) matcher->ruleCount * matcher->ruleCount, sizeof(bool));
+        if ( live == NULL || reported == NULL )
+        {
+            printf("Out of memory.\n");
+            problems++;
+            break;
+        }
+
+        for ( int s = -1; s < matcher->slotCount; s++ )
+        {
+            slot = s < 0 ? &matcher->unnamed : &matcher->slots[s];
+            if ( s >= 0 && slot->procName[0] == 0 )
+                continue;
+
+            covered  = 0;
+            excluded = false;
+            for ( int i = 0; i < slot->count && excluded == false; i++ )
+            {
+                proc = matcher->rules[slot->rules[i]];
+                if ( proc->exclude ? covered != TAMER_ACTION_ALL : (proc->action.fields & ~covered) != 0 )
+                    live[slot->rules[i]] = true;
+
+                /* Overlapping entries above this one that set the same actions win over it */
+                for ( int j = 0; j < i && proc->exclude == false; j++ )
+                {
+                    other  = matcher->rules[slot->rules[j]];
+                    shared = other->action.fields & proc->action.fields;
+
+                    /* A process placed in an entry job stays out of the slice, whichever entry asked for which */
+                    crossed = ((other->action.fields & TAMER_ACTION_SLICE) && (proc->action.fields & TAMER_ACTION_JOB)) ||
+                              ((other->action.fields & TAMER_ACTION_JOB) && (proc->action.fields & TAMER_ACTION_SLICE));
+                    if ( other->exclude || (shared == 0 && crossed == false) || reported[slot->rules[j] * matcher->ruleCount + slot->rules[i]] ||
+                         Tamer_LintOverlap(other, proc) == false )
+                        continue;
+
+                    reported[slot->rules[j] * matcher->ruleCount + slot->rules[i]] = true;
+                    Tamer_LintLabel(other, otherLabel, sizeof(otherLabel));
+                    Tamer_LintLabel(proc, label, sizeof(label));
+                    if ( shared != 0 )
+                    {
+                        printf("Conflict: %s and %s both set %s, %s wins.\n", otherLabel, label, Tamer_LintFields(shared, fields, sizeof(fields)), otherLabel);
+                        conflicts++;
+                    }
+
+                    if ( crossed )
+                    {
+                        printf("Conflict: %s and %s combine Slice with a job, processes matching both stay out of the slice.\n", otherLabel, label);
+                        conflicts++;
+                    }
+                }
+
+                unconditional = proc->procPath[0] == 0 && proc->hasHash == false &&
+                                (proc->action.plugin < 0 || gTamer.plugins[proc->action.plugin].api.match == NULL);
+                if ( unconditional == false )
+                    continue;
+
+                if ( proc->exclude )
+                    excluded = true;
+                else
+                    covered |= proc->action.fields;
+            }
+        }
+
+        for ( int i = 0; i < matcher->ruleCount; i++ )
+        {
+            proc = matcher->rules[i];
+            if ( proc->action.plugin == SRVC_TAME_PLUGIN_MISSING )
+            {
+                printf("Error: %s refers to a plugin that is not loaded, it never matches.\n", Tamer_LintLabel(proc, label, sizeof(label)));
+                problems++;
+            }
+            else if ( live[i] == false )
+            {
+                printf("Error: %s is unreachable, the entries above it always settle %s first.\n", Tamer_LintLabel(proc, label, sizeof(label)),
+                       proc->exclude ? "every action" : Tamer_LintFields(proc->action.fields, fields, sizeof(fields)));
+                problems++;
+            }
+            else if ( (proc->action.fields & TAMER_ACTION_SLICE) && (proc->action.fields & TAMER_ACTION_JOB) )
+            {
+                printf("Error: %s sets Slice along with MaxProcesses, Account or CpuTarget, its processes never join the slice.\n",
+                       Tamer_LintLabel(proc, label, sizeof(label)));
+                problems++;
+            }
+        }
+
+        printf("%d problem(s), %d conflict(s).\n", problems, conflicts);
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    free(reported);
+    free(live);
+
+    return problems;
+}
+
+/**
+ * @brief Report the size of the compiled matcher and time it against the running processes.
+ * The first pass resolves executable paths and digests as the first sweep of the service would,
+ * the following ones reuse them and measure the decision alone, as met by every new process.
+ * @param matcher Pointer to the compiled matcher.
+ */
+
+static void Tamer_LintCost(Tamer_Matcher *matcher)
+{
+    PROCESSENTRY32     *table = NULL, *grown;
+    Tamer_ProcIdentity *idents = NULL;
+    Tamer_Action        action;
+    HANDLE              hSnapShot;
+    LARGE_INTEGER       start, end, frequency;
+    size_t              cells = 0, bytes;
+    int                 used = 0, longest = matcher->unnamed.count, count = 0, capacity = 0, paths = 0, hashes = 0;
+    double              coldUs, warmUs;
+
+    for ( int i = 0; i < matcher->slotCount; i++ )
+    {
+        if ( matcher->slots[i].procName[0] == 0 )
+            continue;
+
+        used++;
+        cells += matcher->slots[i].count;
+        if ( matcher->slots[i].count > longest )
+            longest = matcher->slots[i].count;
+    }
+
+    cells += matcher->unnamed.count;
+    bytes = matcher->ruleCount * sizeof(Tamer_Proc *) + (matcher->slotCount + 1) * sizeof(Tamer_NameSlot) + cells * (sizeof(int) + sizeof(uint32_t));
+    printf("Matcher: %d entries, %d of %d name rows used, %d entries on the unnamed row, longest row %d, %zu cells, %zu bytes.\n", matcher->ruleCount, used,
+           matcher->slotCount, matcher->unnamed.count, longest, cells, bytes);
+
+    do
+    {
+        hSnapShot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if ( hSnapShot == INVALID_HANDLE_VALUE )
+            break;
+
+        for ( BOOL hRes = TRUE; hRes; count++ )
+        {
+            if ( count == capacity )
+            {
+                capacity = capacity ? capacity * 2 : 256;
+                grown    = (PROCESSENTRY32 *) realloc(table, capacity * sizeof(PROCESSENTRY32));
+                if ( grown == NULL )
+                    break;
+                table = grown;
+            }
+
+            table[count].dwSize = sizeof(PROCESSENTRY32);
+            hRes = count == 0 ? Process32First(hSnapShot, &table[count]) : Process32Next(hSnapShot, &table[count]);
+            if ( hRes == FALSE )
+                count--;
+        }
+
+        CloseHandle(hSnapShot);
+
+        idents = (Tamer_ProcIdentity *) calloc(count ? count : 1, sizeof(Tamer_ProcIdentity));
+        if ( table == NULL || idents == NULL || count <= 0 )
+            break;
+
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+        for ( int i = 0; i < count; i++ )
+            Tamer_MatcherDecide(matcher, &table[i], &idents[i], &action);
+        QueryPerformanceCounter(&end);
+        coldUs = (double) (end.QuadPart - start.QuadPart) * 1000000.0 / (double) frequency.QuadPart;
+
+        for ( int i = 0; i < count; i++ )
+        {
+            paths += idents[i].pathQueried;
+            hashes += idents[i].hashQueried;
+        }
+
+        QueryPerformanceCounter(&start);
+        for ( int pass = 0; pass < SRVC_TAME_LINT_PASSES; pass++ )
+        {
+            for ( int i = 0; i < count; i++ )
+                Tamer_MatcherDecide(matcher, &table[i], &idents[i], &action);
+        }
+        QueryPerformanceCounter(&end);
+        warmUs = (double) (end.QuadPart - start.QuadPart) * 1000000.0 / (double) frequency.QuadPart / SRVC_TAME_LINT_PASSES;
+
+        printf("Process table: %d processes, %d executable paths and %d digests needed.\n", count, paths, hashes);
+        printf("First sweep: %.0f us, %.2f us per process.\n", coldUs, coldUs / count);
+        printf("Later sweeps: %.2f us per new process, %.0f us if every process were new.\n", warmUs / count, warmUs);
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    free(idents);
+    free(table);
+}
+
+/**
+ * @brief Compile the configuration as the service would and report on it, without taming anything.
+ * @retval int EXIT_SUCCESS when no problem was found, EXIT_FAILURE otherwise.
+ */
+
+static int Tamer_Lint(void)
+{
+    Tamer_Proc *el;
+    int         problems;
+
+    printf("Configuration: %s\n", gTamer.config->filePath);
+
+    LL_FOREACH(gTamer.config->procList, el)
+    {
+        if ( el->hasHash )
+        {
+            Tamer_HashCacheInit();
+            break;
+        }
+    }
+
+    problems = Tamer_LintRules(&gTamer.config->matcher);
+    Tamer_LintCost(&gTamer.config->matcher);
+
+    return problems == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Self check of the CPU cap controller, on a simulated machine and a virtual clock.
+ * A capped job wants more than the target leaves it next to a background load, which then
+ * steps up; the job later goes quiet and comes back. Steps come at irregular times, like the
+ * early checks on process creations. Each phase has to settle within SRVC_TAME_CHECK_SETTLE
+ * check intervals, on the target or on whatever use the load leaves below it.
+ * @return true if every phase settled.
+ */
+
+static bool Tamer_CheckCpuCap(void)
+{
+    static const struct
+    {
+        double background; /* Use outside of the capped job, percent */
+        double demand;     /* Use the capped job would have uncapped, percent */
+
+    } phases[] = {{20.0, 80.0}, {50.0, 80.0}, {20.0, 10.0}, {20.0, 80.0}};
+    static const uint32_t gaps[] = {10000, 10000, 2000, 700, 10000}; /* Virtual ms between two checks */
+    const uint32_t        interval = 10000, length = 60 * interval, target = 60;
+    double                cap = 100.0, integral = 100.0, use, expected;
+    uint64_t              now = 0, phaseStart, settled;
+    bool                  retVal = true;
+    int                   g      = 0;
+
+    printf("CpuCap: target %u%%, %u ms interval, virtual clock.\n", target, interval);
+
+    for ( size_t p = 0; p < sizeof(phases) / sizeof(phases[0]); p++ )
+    {
+        expected   = phases[p].background + phases[p].demand < target ? phases[p].background + phases[p].demand : target;
+        phaseStart = now;
+        settled    = now;
+
+        while ( now - phaseStart < length )
+        {
+            uint32_t gap = gaps[g++ % (sizeof(gaps) / sizeof(gaps[0]))];
+
+            /* The use measured over a step is the one the cap of the previous step allowed */
+            use = phases[p].background + (phases[p].demand < cap ? phases[p].demand : cap);
+            now += gap;
+            cap = Tamer_CpuCapStep(target, use, (double) gap / interval, cap, &integral);
+
+            if ( use < expected - 1.0 || use > expected + 1.0 )
+                settled = now;
+        }
+
+        printf("CpuCap: background %.0f%%, job %.0f%%: use %.1f%%, cap %.1f%%, settled in %.1f intervals\n", phases[p].background,
+               phases[p].demand, use, cap, (double) (settled - phaseStart) / interval);
+
+        if ( settled - phaseStart > (uint64_t) SRVC_TAME_CHECK_SETTLE * interval )
+            retVal = false;
+    }
+
+    printf("CpuCap: %s\n", retVal ? "passed" : "FAILED");
+    return retVal;
+}
+
+/**
+ * @brief Self check of the process handle cache, against the processes running on the machine.
+ * Simulated sweeps open every process the service could tame through the cache, sized from
+ * nothing to the whole set, and the cost of a lookup is timed for each size. With room for
+ * the whole set, every sweep but the first has to hit, and a hit has to beat an open.
+ * @return true if the cache held the set and paid off.
+ */
+
+static bool Tamer_CheckHandleCache(void)
+{
+    DWORD          *pids = NULL;
+    int             count = 0, size = 0, capacity, sizes[4];
+    PROCESSENTRY32  pEntry;
+    HANDLE          hSnapShot, hProcess;
+    BOOL            hRes;
+    bool            cached, retVal = true;
+    uint64_t        startTime;
+    double          cost, uncached = 0.0;
+    LARGE_INTEGER   start, end, frequency;
+    uint32_t        round = gTamer.round;
+
+    hSnapShot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if ( hSnapShot == INVALID_HANDLE_VALUE )
+        return false;
+
+    /* The processes this console may open, as the service would open tamed ones */
+    pEntry.dwSize = sizeof(pEntry);
+    hRes          = Process32First(hSnapShot, &pEntry);
+    while ( hRes )
+    {
+        hProcess = OpenProcess(SRVC_TAME_PROCESS_ACCESS, FALSE, pEntry.th32ProcessID);
+        if ( hProcess != NULL )
+        {
+            CloseHandle(hProcess);
+            if ( count == size )
+            {
+                DWORD *grown = (DWORD *) realloc(pids, (size ? size * 2 : 256) * sizeof(DWORD));
+                if ( grown == NULL )
+                    break;
+
+                pids = grown;
+                size = size ? size * 2 : 256;
+            }
+
+            pids[count++] = pEntry.th32ProcessID;
+        }
+
+        hRes = Process32Next(hSnapShot, &pEntry);
+    }
+
+    CloseHandle(hSnapShot);
+
+    if ( count == 0 )
+    {
+        free(pids);
+        printf("HandleCache: no process could be opened, run as an administrator.\n");
+        return false;
+    }
+
+    sizes[0] = 0;
+    sizes[1] = count / 4;
+    sizes[2] = count / 2;
+    sizes[3] = count;
+
+    QueryPerformanceFrequency(&frequency);
+    printf("HandleCache: %d processes, %d simulated sweeps.\n", count, SRVC_TAME_CHECK_PASSES);
+
+    for ( int c = 0; c < 4; c++ )
+    {
+        capacity = sizes[c];
+        while ( gTamer.handleCache.lru != NULL )
+            Tamer_HandleEvict(gTamer.handleCache.lru);
+
+        gTamer.handleCache.capacity  = capacity;
+        gTamer.handleCache.hits      = 0;
+        gTamer.handleCache.misses    = 0;
+        gTamer.handleCache.evictions = 0;
+
+        QueryPerformanceCounter(&start);
+        for ( int pass = 0; pass < SRVC_TAME_CHECK_PASSES; pass++ )
+        {
+            gTamer.round++;
+            for ( int i = 0; i < count; i++ )
+            {
+                hProcess = Tamer_HandleOpen(pids[i], &startTime, &cached);
+                if ( hProcess != NULL )
+                {
+                    GetPriorityClass(hProcess);
+                    Tamer_HandleClose(hProcess, cached);
+                }
+            }
+        }
+        QueryPerformanceCounter(&end);
+
+        cost = (double) (end.QuadPart - start.QuadPart) * 1000000.0 / (double) frequency.QuadPart / ((double) count * SRVC_TAME_CHECK_PASSES);
+        if ( capacity == 0 )
+            uncached = cost;
+
+        printf("HandleCache: capacity %5d: %.2f us per lookup, %llu hits, %llu misses, %llu evictions, %d handles held\n", capacity, cost,
+               (unsigned long long) gTamer.handleCache.hits, (unsigned long long) gTamer.handleCache.misses,
+               (unsigned long long) gTamer.handleCache.evictions, gTamer.handleCache.count);
+
+        /* Processes exiting meanwhile miss, a few of them at most */
+        if ( capacity == count && (gTamer.handleCache.hits < (uint64_t) count * (SRVC_TAME_CHECK_PASSES - 1) * 9 / 10 || cost >= uncached) )
+            retVal = false;
+    }
+
+    while ( gTamer.handleCache.lru != NULL )
+        Tamer_HandleEvict(gTamer.handleCache.lru);
+
+    memset(&gTamer.handleCache, 0, sizeof(gTamer.handleCache));
+    gTamer.round = round;
+    free(pids);
+
+    printf("HandleCache: %s\n", retVal ? "passed" : "FAILED");
+    return retVal;
+}
+
+/**
+ * @brief Compare two latencies, for qsort.
+ * @param a Pointer to the first latency.
+ * @param b Pointer to the second latency.
+ * @retval int Negative, zero or positive as a is lower, equal or greater.
+ */
+
+static int Tamer_CheckCompare(const void *a, const void *b)
+{
+    uint64_t latencyA = *(const uint64_t *) a;
+    uint64_t latencyB = *(const uint64_t *) b;
+
+    return (latencyA > latencyB) - (latencyA < latencyB);
+}
+
+/**
+ * @brief Start this executable as a load generating child process of the self checks.
+ * @param args Arguments following '-t'.
+ * @param processInfo Output, the child process and its main thread.
+ * @param suspended true to start it suspended, so it can be tamed before it runs.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_CheckSpawn(const char *args, PROCESS_INFORMATION *processInfo, bool suspended)
+{
+    char        exePath[MAX_PATH];
+    char        commandLine[MAX_PATH * 2 + 64];
+    STARTUPINFO startupInfo;
+
+    if ( GetModuleFileName(NULL, exePath, MAX_PATH) == 0 )
+        return false;
+
+    snprintf(commandLine, sizeof(commandLine), "\"%s\" -t %s", exePath, args);
+    memset(&startupInfo, 0, sizeof(startupInfo));
+    startupInfo.cb = sizeof(startupInfo);
+
+    return CreateProcess(NULL, commandLine, NULL, NULL, FALSE, CREATE_NO_WINDOW | (suspended ? CREATE_SUSPENDED : 0), NULL, NULL, &startupInfo,
+                         processInfo) != FALSE;
+}
+
+/**
+ * @brief Stop a child process of the self checks.
+ * @param processInfo Pointer to the child process and its main thread.
+ */
+
+static void Tamer_CheckKill(PROCESS_INFORMATION *processInfo)
+{
+    TerminateProcess(processInfo->hProcess, 0);
+    WaitForSingleObject(processInfo->hProcess, INFINITE);
+    CloseHandle(processInfo->hThread);
+    CloseHandle(processInfo->hProcess);
+}
+
+/**
+ * @brief Get the processor time of the calling thread so far.
+ * @retval uint64_t Kernel and user time, 100ns units.
+ */
+
+static uint64_t Tamer_CheckThreadCpu(void)
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if ( GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime) == FALSE )
+        return 0;
+
+    return (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+           (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+}
+
+/**
+ * @brief Load generating child process of the self checks, runs until its parent terminates it.
+ * 'scan <file>' reads a file over and over, bypassing the file cache.
+ * 'agent <busy> <idle>' spins for 'busy' ms of processor time, then sleeps for 'idle' ms, and again.
+ * 'memory <MB>' touches that much memory once, then sleeps.
+ * @param argc Argument count, past '-t'.
+ * @param argv Arguments, past '-t'.
+ * @retval int EXIT_FAILURE on a bad argument or error.
+ */
+
+static int Tamer_CheckChild(int argc, char **argv)
+{
+    HANDLE   hFile;
+    DWORD    read;
+    void    *buffer;
+    uint64_t turnStart;
+
+    if ( argc == 3 && _stricmp(argv[0], "agent") == 0 )
+    {
+        /* Processor time is in 100ns units, 10000 per millisecond */
+        for ( ;; )
+        {
+            turnStart = Tamer_CheckThreadCpu();
+            while ( Tamer_CheckThreadCpu() - turnStart < (uint64_t) atoi(argv[1]) * 10000 )
+                ;
+
+            Sleep((DWORD) atoi(argv[2]));
+        }
+    }
+
+    if ( argc == 2 && _stricmp(argv[0], "memory") == 0 )
+    {
+        SIZE_T size = (SIZE_T) atoi(argv[1]) * 1024 * 1024;
+        char  *memory = (char *) VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+        if ( memory == NULL )
+            return EXIT_FAILURE;
+
+        for ( SIZE_T i = 0; i < size; i += 4096 )
+            memory[i] = (char) i;
+
+        Sleep(INFINITE);
+    }
+
+    if ( argc == 2 && _stricmp(argv[0], "scan") == 0 )
+    {
+        hFile  = CreateFile(argv[1], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        buffer = VirtualAlloc(NULL, 1024 * 1024, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if ( hFile == INVALID_HANDLE_VALUE || buffer == NULL )
+            return EXIT_FAILURE;
+
+        for ( ;; )
+        {
+            if ( ReadFile(hFile, buffer, 1024 * 1024, &read, NULL) == FALSE )
+                return EXIT_FAILURE;
+
+            if ( read == 0 )
+                SetFilePointer(hFile, 0, NULL, FILE_BEGIN);
+        }
+    }
+
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Create a file of a given size for the self checks.
+ * @param path File path.
+ * @param megabytes File size, MB.
+ * @return true on success, false otherwise.
+ */
+
+static bool Tamer_CheckFile(const char *path, uint32_t megabytes)
+{
+    HANDLE hFile;
+    DWORD  written;
+    char  *buffer;
+    bool   retVal = true;
+
+    hFile = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if ( hFile == INVALID_HANDLE_VALUE )
+        return false;
+
+    buffer = (char *) malloc(1024 * 1024);
+    for ( uint32_t i = 0; buffer != NULL && i < megabytes && retVal; i++ )
+    {
+        memset(buffer, (int) i, 1024 * 1024);
+        retVal = WriteFile(hFile, buffer, 1024 * 1024, &written, NULL) && written == 1024 * 1024;
+    }
+
+    retVal = retVal && buffer != NULL && FlushFileBuffers(hFile);
+    free(buffer);
+    CloseHandle(hFile);
+
+    return retVal;
+}
+
+/**
+ * @brief Self check of the I/O priority action: foreground random read latency next to a background scanner.
+ * A child process scans a file sequentially, bypassing the file cache, while the foreground
+ * times random 4 KB reads of another file on the same volume. This is done with no scanner,
+ * then with the scanner at normal and at very low I/O priority, set by the same call as the
+ * IoPrio action. How much the priority helps is up to the storage stack, the check reports
+ * the read latency percentiles of each setting, and fails only when it could not measure.
+ * @return true if every setting was measured.
+ */
+
+static bool Tamer_CheckIoPriority(void)
+{
+    static const struct
+    {
+        const char *name;
+        int         ioPriority; /* -1 without scanner */
+
+    } settings[] = {{"no scanner", -1}, {"scanner at normal", TAMER_IO_PRIORITY_NORMAL}, {"scanner at very low", TAMER_IO_PRIORITY_VERY_LOW}};
+    char                tempPath[MAX_PATH], scanPath[MAX_PATH + 32], readPath[MAX_PATH + 32], args[MAX_PATH + 64];
+    PROCESS_INFORMATION scanner;
+    uint64_t           *latencies;
+    uint32_t            blocks = SRVC_TAME_CHECK_READ_MB * 256, reads;
+    LARGE_INTEGER       start, end, frequency, offset;
+    ULONGLONG           until;
+    HANDLE              hFile;
+    DWORD               read;
+    void               *buffer;
+    bool                retVal = false;
+
+    if ( gTamer.nt.SetInformationProcess == NULL || GetTempPath(MAX_PATH, tempPath) == 0 )
+        return false;
+
+    snprintf(scanPath, sizeof(scanPath), "%sSrvcTame.scan.tmp", tempPath);
+    snprintf(readPath, sizeof(readPath), "%sSrvcTame.read.tmp", tempPath);
+    snprintf(args, sizeof(args), "scan \"%s\"", scanPath);
+
+    latencies = (uint64_t *) malloc(SRVC_TAME_CHECK_IO_READS * sizeof(uint64_t));
+    buffer    = VirtualAlloc(NULL, 4096, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    QueryPerformanceFrequency(&frequency);
+
+    do
+    {
+        if ( latencies == NULL || buffer == NULL )
+            break;
+
+        printf("IoPrio: writing %u MB of test files to %s\n", SRVC_TAME_CHECK_SCAN_MB + SRVC_TAME_CHECK_READ_MB, tempPath);
+        if ( Tamer_CheckFile(scanPath, SRVC_TAME_CHECK_SCAN_MB) == false || Tamer_CheckFile(readPath, SRVC_TAME_CHECK_READ_MB) == false )
+            break;
+
+        hFile = CreateFile(readPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_RANDOM_ACCESS, NULL);
+        if ( hFile == INVALID_HANDLE_VALUE )
+            break;
+
+        retVal = true;
+        srand((unsigned) GetTickCount());
+        for ( size_t i = 0; i < sizeof(settings) / sizeof(settings[0]) && retVal; i++ )
+        {
+            if ( settings[i].ioPriority >= 0 )
+            {
+                if ( Tamer_CheckSpawn(args, &scanner, true) == false )
+                {
+                    retVal = false;
+                    break;
+                }
+
+                /* Tamed before it issues its first read */
+                Tamer_SetIoPriority(scanner.hProcess, (ULONG) settings[i].ioPriority);
+                ResumeThread(scanner.hThread);
+                Sleep(500);
+            }
+
+            reads = 0;
+            until = GetTickCount64() + SRVC_TAME_CHECK_IO_MS;
+            while ( GetTickCount64() < until && reads < SRVC_TAME_CHECK_IO_READS )
+            {
+                offset.QuadPart = (LONGLONG) (((uint32_t) rand() * ((uint32_t) RAND_MAX + 1) + (uint32_t) rand()) % blocks) * 4096;
+                SetFilePointerEx(hFile, offset, NULL, FILE_BEGIN);
 
-            CloseServiceHandle(hService);
+                QueryPerformanceCounter(&start);
+                if ( ReadFile(hFile, buffer, 4096, &read, NULL) == FALSE )
+                    break;
+                QueryPerformanceCounter(&end);
+
+                latencies[reads++] = (uint64_t) (end.QuadPart - start.QuadPart) * 1000000 / (uint64_t) frequency.QuadPart;
+            }
+
+            if ( settings[i].ioPriority >= 0 )
+                Tamer_CheckKill(&scanner);
+
+            if ( reads == 0 )
+            {
+                retVal = false;
+                break;
+            }
+
+            qsort(latencies, reads, sizeof(uint64_t), Tamer_CheckCompare);
+            printf("IoPrio: %-19s: %6u reads, p50 %5llu us, p99 %6llu us\n", settings[i].name, reads, (unsigned long long) latencies[reads / 2],
+                   (unsigned long long) latencies[reads * 99 / 100]);
         }
 
-        CloseServiceHandle(hSCManager);
-    }
+        CloseHandle(hFile);
 
+    } while ( 0 );
+
+    /* Cleanup section */
+    DeleteFile(scanPath);
+    DeleteFile(readPath);
+
+    if ( buffer != NULL )
+        VirtualFree(buffer, 0, MEM_RELEASE);
+
+    free(latencies);
+
+    printf("IoPrio: %s\n", retVal ? "measured" : "FAILED");
     return retVal;
 }
 
 /**
- * @brief Installs the service.
- * @param procName Name of the executable to run as service.
- * @retval int EXIT_SUCCESS on success, EXIT_FAILURE on failure.
+ * @brief Run background agents side by side and sample how many of them are busy at once.
+ * @param serialize true to put them in a serialize group, whose turns are handed over every half second.
+ * @param peak Output, most agents busy at once over a sample.
+ * @param mean Output, agents busy at once on average.
+ * @param work Output, processor time the agents got, seconds.
+ * @param rotations Output, turns handed over.
+ * @return true on success, false otherwise.
  */
 
-static int Tamer_ServiceInstall(char *procName, const char *serviceName, const char *serviceDisplayName, const char *serviceDescription)
+static bool Tamer_CheckAgents(bool serialize, uint32_t *peak, double *mean, double *work, uint64_t *rotations)
 {
-    int       retVal     = EXIT_FAILURE;
-    char      path[512]  = {0};
-    SC_HANDLE hSCManager = OpenSCManager(NULL, NULL, SC_MANAGER_CREATE_SERVICE);
+    PROCESS_INFORMATION agents[SRVC_TAME_CHECK_AGENTS];
+    Tamer_LimitGroup   *group;
+    Tamer_Proc          rule;
+    FILETIME            creationTime, exitTime, kernelTime, userTime;
+    uint64_t            cpuTime[SRVC_TAME_CHECK_AGENTS], first[SRVC_TAME_CHECK_AGENTS], now, busySum = 0;
+    uint32_t            busy, samples = 0, interval = gTamer.config->interval;
+    int                 spawned = 0;
+    bool                retVal  = true;
 
-    if ( hSCManager )
+    memset(&rule, 0, sizeof(rule));
+    snprintf(rule.serializeGroup, sizeof(rule.serializeGroup), "SelfCheck");
+
+    *peak      = 0;
+    *rotations = 0;
+    for ( ; spawned < SRVC_TAME_CHECK_AGENTS; spawned++ )
     {
-        GetFullPathName(procName, sizeof(path), path, NULL);
+        if ( Tamer_CheckSpawn("agent 1000 1500", &agents[spawned], false) == false )
+        {
+            retVal = false;
+            break;
+        }
 
-        SC_HANDLE hService = CreateService(hSCManager, serviceName, serviceDisplayName, SERVICE_ALL_ACCESS, SERVICE_WIN32_OWN_PROCESS, SERVICE_AUTO_START,
-                                           SERVICE_ERROR_NORMAL, path, NULL, NULL, NULL, NULL, NULL);
+        first[spawned] = cpuTime[spawned] = 0;
+        if ( serialize )
+            Tamer_LimitTrack(agents[spawned].dwProcessId, &rule, true);
+    }
 
-        if ( hService )
+    /* Turns are handed over by the check, which runs every half second here */
+    gTamer.config->interval = 500;
+    for ( uint32_t t = 0; retVal && t < SRVC_TAME_CHECK_AGENT_MS; t += 100 )
+    {
+        Sleep(100);
+        if ( serialize && t % 500 == 400 )
+            Tamer_SerializeRotate();
+
+        busy = 0;
+        for ( int i = 0; i < spawned; i++ )
         {
-            SERVICE_DESCRIPTION desc;
-            desc.lpDescription = (LPSTR) serviceDescription;
+            if ( GetProcessTimes(agents[i].hProcess, &creationTime, &exitTime, &kernelTime, &userTime) == FALSE )
+                continue;
 
-            if ( ChangeServiceConfig2(hService, SERVICE_CONFIG_DESCRIPTION, &desc) )
-                retVal = EXIT_SUCCESS;
-            CloseServiceHandle(hService);
+            now = (((uint64_t) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime) +
+                  (((uint64_t) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime);
+            if ( t == 0 )
+                first[i] = now;
+
+            /* Busy over the sample: more than half a processor, 500000 units of 100ns out of 100 ms */
+            if ( t > 0 && now - cpuTime[i] > 500000 )
+                busy++;
+
+            cpuTime[i] = now;
         }
 
-        CloseServiceHandle(hSCManager);
+        if ( t > 0 )
+        {
+            busySum += busy;
+            samples++;
+            if ( busy > *peak )
+                *peak = busy;
+        }
+    }
+
+    gTamer.config->interval = interval;
+    if ( gTamer.limiter.initialized )
+    {
+        LL_FOREACH(gTamer.limiter.groups, group)
+            *rotations += group->rotations;
+    }
+
+    Tamer_LimitReset();
+
+    *work = 0.0;
+    for ( int i = 0; i < spawned; i++ )
+    {
+        *work += (double) (cpuTime[i] - first[i]) / 10000000.0;
+        Tamer_CheckKill(&agents[i]);
     }
 
+    *mean = samples ? (double) busySum / samples : 0.0;
     return retVal;
 }
 
 /**
- * @brief Sets the priority of a process to idle.
- * @param exeName Name of the executable whose priority to adjust.
+ * @brief Self check of serialize groups: background agents that overlap, then take turns.
+ * Agents alternate a second of work and a second and a half of sleep. Run side by side they
+ * overlap, in a serialize group at most one of them may be busy at any time.
+ * @return true if the group let at most one agent run at once, and did hand turns over.
  */
 
-static void Tamer_SetProcessPriority(Tamer_Proc *proc)
+static bool Tamer_CheckSerialize(void)
 {
+    uint32_t peak;
+    double   mean, work;
+    uint64_t rotations;
+    bool     retVal;
 
-    HANDLE         hProcess;
-    HANDLE         hSnapShot = CreateToolhelp32Snapshot(TH32CS_SNAPALL, 0);
-    PROCESSENTRY32 pEntry;
-    pEntry.dwSize = sizeof(pEntry);
-    BOOL hRes     = Process32First(hSnapShot, &pEntry);
+    if ( gTamer.nt.SuspendProcess == NULL || gTamer.nt.ResumeProcess == NULL )
+        return false;
 
-    while ( hRes )
+    retVal = Tamer_CheckAgents(false, &peak, &mean, &work, &rotations);
+    if ( retVal )
+        printf("Serialize: %d agents alone     : %u busy at peak, %.2f on average, %.1f s of processor\n", SRVC_TAME_CHECK_AGENTS, peak, mean, work);
+
+    retVal = retVal && Tamer_CheckAgents(true, &peak, &mean, &work, &rotations);
+    if ( retVal )
+    {
+        printf("Serialize: %d agents serialized: %u busy at peak, %.2f on average, %.1f s of processor, %llu turns handed over\n",
+               SRVC_TAME_CHECK_AGENTS, peak, mean, work, (unsigned long long) rotations);
+        retVal = peak <= 1 && rotations > 0;
+    }
+
+    printf("Serialize: %s\n", retVal ? "passed" : "FAILED");
+    return retVal;
+}
+
+/*! @brief  Self check: entry of the hash table the PID table is compared to */
+typedef struct __Tamer_CheckNode
+{
+    DWORD                     pid;
+    uint32_t                  slot;
+    struct __Tamer_CheckNode *next;
+
+} Tamer_CheckNode;
+
+/**
+ * @brief Self check pseudo random numbers, xorshift.
+ * @param seed Pointer to the generator state, not 0.
+ * @retval uint32_t Next number.
+ */
+
+static uint32_t Tamer_CheckRandom(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+
+    return *seed;
+}
+
+/**
+ * @brief Self check of the PID table against a chained hash table, at 1k, 30k and 300k processes.
+ * PIDs are distinct multiples of 4, a quarter of those below the highest one in use, and are
+ * looked up in random order, as a sweep meets them. Walking every entry is timed as well: the
+ * table only visits allocated pages, the hash table every bucket.
+ * @return true if both tables found every PID.
+ */
+
+static bool Tamer_CheckPidTable(void)
+{
+    static const uint32_t counts[] = {1000, 30000, 300000};
+    Tamer_CheckNode     **buckets = NULL, *nodes = NULL, *node;
+    DWORD                *pids    = NULL;
+    uint32_t              seed = 2463534242u, count, mask, found, passes;
+    Tamer_PidPage        *page;
+    LARGE_INTEGER         start, end, frequency;
+    double                tableNs, hashNs, tableWalk, hashWalk;
+    bool                  retVal = true;
+
+    QueryPerformanceFrequency(&frequency);
+
+    for ( size_t c = 0; c < sizeof(counts) / sizeof(counts[0]) && retVal; c++ )
     {
-        if ( _stricmp(pEntry.szExeFile, proc->procName) == 0 )
+        count = counts[c];
+        for ( mask = 1; mask < count; mask <<= 1 )
+            ;
+
+        pids    = (DWORD *) malloc(count * 4 * sizeof(DWORD));
+        nodes   = (Tamer_CheckNode *) malloc(count * sizeof(Tamer_CheckNode));
+        buckets = (Tamer_CheckNode **) calloc(mask, sizeof(Tamer_CheckNode *));
+        if ( pids == NULL || nodes == NULL || buckets == NULL )
+        {
+            retVal = false;
+            break;
+        }
+
+        /* A random quarter of the PIDs below count * 16, shuffled */
+        for ( uint32_t i = 0; i < count * 4; i++ )
+            pids[i] = (i + 1) * 4;
+        for ( uint32_t i = count * 4 - 1; i > 0; i-- )
         {
+            uint32_t j   = Tamer_CheckRandom(&seed) % (i + 1);
+            DWORD    pid = pids[i];
 
-            hProcess = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pEntry.th32ProcessID);
+            pids[i] = pids[j];
+            pids[j] = pid;
+        }
 
-            if ( hProcess != NULL )
+        for ( uint32_t i = 0; i < count; i++ )
+        {
+            Tamer_PidLink(pids[i], i + 1);
+            nodes[i].pid  = pids[i];
+            nodes[i].slot = i + 1;
+            LL_PREPEND(buckets[(pids[i] >> 2) & (mask - 1)], &nodes[i]);
+        }
+
+        passes = SRVC_TAME_CHECK_LOOKUPS / count;
+
+        /* Lookups, the table as Tamer_StateLookup() does */
+        found = 0;
+        QueryPerformanceCounter(&start);
+        for ( uint32_t p = 0; p < passes; p++ )
+        {
+            for ( uint32_t i = 0; i < count; i++ )
             {
-                if ( GetPriorityClass(hProcess) != IDLE_PRIORITY_CLASS )
-                    SetPriorityClass(hProcess, IDLE_PRIORITY_CLASS);
+                page = Tamer_PidPageGet(pids[i], false);
+                found += page != NULL && page->slot[(pids[i] >> 2) & (SRVC_TAME_PID_PAGE - 1)] == i + 1;
+            }
+        }
+        QueryPerformanceCounter(&end);
+        tableNs = (double) (end.QuadPart - start.QuadPart) * 1e9 / (double) frequency.QuadPart / ((double) passes * count);
+        retVal  = found == passes * count;
 
-                CloseHandle(hProcess);
+        found = 0;
+        QueryPerformanceCounter(&start);
+        for ( uint32_t p = 0; p < passes; p++ )
+        {
+            for ( uint32_t i = 0; i < count; i++ )
+            {
+                LL_SEARCH_SCALAR(buckets[(pids[i] >> 2) & (mask - 1)], node, pid, pids[i]);
+                found += node != NULL && node->slot == i + 1;
             }
         }
+        QueryPerformanceCounter(&end);
+        hashNs = (double) (end.QuadPart - start.QuadPart) * 1e9 / (double) frequency.QuadPart / ((double) passes * count);
+        retVal = retVal && found == passes * count;
 
-        hRes = Process32Next(hSnapShot, &pEntry);
+        /* Walks, every tracked process once */
+        found = 0;
+        QueryPerformanceCounter(&start);
+        for ( uint32_t i = 0; i < gTamer.pids.pageCount; i++ )
+        {
+            if ( gTamer.pids.pages[i] == NULL )
+                continue;
+
+            for ( uint32_t j = 0; j < SRVC_TAME_PID_PAGE; j++ )
+                found += gTamer.pids.pages[i]->slot[j] != 0;
+        }
+        QueryPerformanceCounter(&end);
+        tableWalk = (double) (end.QuadPart - start.QuadPart) * 1e6 / (double) frequency.QuadPart;
+        retVal    = retVal && found == count;
+
+        found = 0;
+        QueryPerformanceCounter(&start);
+        for ( uint32_t i = 0; i < mask; i++ )
+        {
+            LL_FOREACH(buckets[i], node)
+                found++;
+        }
+        QueryPerformanceCounter(&end);
+        hashWalk = (double) (end.QuadPart - start.QuadPart) * 1e6 / (double) frequency.QuadPart;
+        retVal   = retVal && found == count;
+
+        printf("PidTable: %6u PIDs: lookup %5.1f ns, hash %5.1f ns; walk %7.1f us over %u pages, hash %7.1f us over %u buckets\n", count, tableNs,
+               hashNs, tableWalk, gTamer.pids.allocated, hashWalk, mask);
+
+        /* Cleanup section */
+        for ( uint32_t i = 0; i < gTamer.pids.pageCount; i++ )
+            free(gTamer.pids.pages[i]);
+
+        free(gTamer.pids.pages);
+        memset(&gTamer.pids, 0, sizeof(gTamer.pids));
+        free(pids);
+        free(nodes);
+        free(buckets);
+        pids    = NULL;
+        nodes   = NULL;
+        buckets = NULL;
     }
 
-    CloseHandle(hSnapShot);
+    free(pids);
+    free(nodes);
+    free(buckets);
+
+    printf("PidTable: %s\n", retVal ? "passed" : "FAILED");
+    return retVal;
 }
 
 /**
- * @brief Controls the service based on the request code.
- * @param request Control code for the service.
+ * @brief Self check of the trim action on an idle agent holding cold memory.
+ * A child process touches SRVC_TAME_CHECK_MEMORY_MB of memory and goes idle. It is given a very
+ * low memory priority and trimmed through the same calls as the MemPrio and Trim actions, then
+ * left alone for two seconds. Its pages go to the standby and modified lists, the first ones
+ * repurposed when memory runs short, so the working set drop is what the foreground gains.
+ * @return true if most of its working set left and stayed out, and it was trimmed once per idle period.
  */
-static void Tamer_ServiceControl(DWORD request)
+
+static bool Tamer_CheckTrim(void)
 {
-    /* Intended only when running as a service */
-    if ( gTamer.serviceMode == false )
-        return;
+    PROCESS_INFORMATION     agent;
+    PROCESS_MEMORY_COUNTERS before, trimmed, later;
+    Tamer_StateEntry        entry;
+    ULONG                   memoryPriority = MEMORY_PRIORITY_NORMAL;
+    uint64_t                trims = gTamer.trims;
+    uint32_t                sweepGap = gTamer.sweepGap;
+    char                    args[32];
+    bool                    retVal = false;
 
-    switch ( request )
+    snprintf(args, sizeof(args), "memory %u", SRVC_TAME_CHECK_MEMORY_MB);
+    if ( Tamer_CheckSpawn(args, &agent, false) == false )
+        return false;
+
+    memset(&entry, 0, sizeof(entry));
+    gTamer.sweepGap = gTamer.config->interval;
+
+    do
     {
-        case SERVICE_CONTROL_STOP:
-        case SERVICE_CONTROL_SHUTDOWN:
-            gTamer.ServiceStatus.dwCurrentState = SERVICE_STOPPED;
-            SetServiceStatus(gTamer.hStatus, &gTamer.ServiceStatus);
+        /* Wait for the agent to touch its memory */
+        for ( int i = 0; i < 100; i++ )
+        {
+            Sleep(100);
+            if ( GetProcessMemoryInfo(agent.hProcess, &before, sizeof(before)) == FALSE )
+                break;
+
+            if ( before.WorkingSetSize >= (SIZE_T) SRVC_TAME_CHECK_MEMORY_MB * 1024 * 1024 * 9 / 10 )
+                break;
+        }
+
+        if ( Tamer_SetMemoryPriority(agent.hProcess, MEMORY_PRIORITY_VERY_LOW) == false ||
+             Tamer_GetMemoryPriority(agent.hProcess, &memoryPriority) == false )
             break;
-        default:
-            SetServiceStatus(gTamer.hStatus, &gTamer.ServiceStatus);
+
+        /* Idle over the last check, trimmed; still idle at the next one, left alone */
+        Tamer_TrimIdle(agent.hProcess, &entry, true, 0);
+        if ( GetProcessMemoryInfo(agent.hProcess, &trimmed, sizeof(trimmed)) == FALSE )
             break;
-    }
+
+        Sleep(2000);
+        Tamer_TrimIdle(agent.hProcess, &entry, true, 0);
+        if ( GetProcessMemoryInfo(agent.hProcess, &later, sizeof(later)) == FALSE )
+            break;
+
+        printf("Trim: idle agent, memory priority %lu: working set %llu MB, %llu MB once trimmed, %llu MB 2 s later, %lu page faults meanwhile\n",
+               (unsigned long) memoryPriority, (unsigned long long) (before.WorkingSetSize >> 20), (unsigned long long) (trimmed.WorkingSetSize >> 20),
+               (unsigned long long) (later.WorkingSetSize >> 20), (unsigned long) (later.PageFaultCount - trimmed.PageFaultCount));
+
+        retVal = memoryPriority == MEMORY_PRIORITY_VERY_LOW && gTamer.trims == trims + 1 && trimmed.WorkingSetSize < before.WorkingSetSize / 4 &&
+                 later.WorkingSetSize < before.WorkingSetSize / 4;
+
+        /* Busy again, the next idle period trims it again */
+        Tamer_TrimIdle(agent.hProcess, &entry, true, (uint64_t) gTamer.sweepGap * 10000);
+        retVal = retVal && (entry.applied & TAMER_ACTION_TRIM) == 0;
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    gTamer.sweepGap = sweepGap;
+    Tamer_CheckKill(&agent);
+
+    printf("Trim: %s\n", retVal ? "passed" : "FAILED");
+    return retVal;
 }
 
 /**
- * @brief Initializes the service settings.
- * @retval bool true if initialization succeeds, false otherwise.
+ * @brief Self check of the slice, on a stand-in job object private to the check.
+ * Agents holding 16 MB each are queued as a sweep would, and moved in by one flush into a
+ * job named after this console process, so the slice of a running service is left alone.
+ * The properties are read back from the job, queuing the agents again must not move them
+ * again, and resetting the slice has to lift its properties.
+ * @return true if every agent joined in one batch and the job carried the properties once.
  */
 
-static bool Tamer_ServiceInit(void)
+static bool Tamer_CheckSlice(void)
 {
-    /* Intended only when running as a service */
-    if ( gTamer.serviceMode == false )
-        return false;
+    PROCESS_INFORMATION                    agents[SRVC_TAME_CHECK_SLICED];
+    PROCESS_MEMORY_COUNTERS                counters;
+    JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION   limits;
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION cpuRate;
+    Tamer_Config                           config = *gTamer.config;
+    Tamer_Config                          *saved  = gTamer.config;
+    LARGE_INTEGER                          start, end, frequency;
+    uint64_t                               assigned;
+    SIZE_T                                 workingSet = 0;
+    BOOL                                   inJob;
+    int                                    spawned = 0;
+    bool                                   retVal  = false;
 
-    /* Placeholder */
-    return true;
+    /* The stand-in: a slice of its own, with known properties */
+    snprintf(config.sliceName, sizeof(config.sliceName), "SrvcTame.SelfCheck.%lu", (unsigned long) GetCurrentProcessId());
+    config.sliceCpuWeight  = 5;
+    config.sliceMemoryHigh = 8;
+    gTamer.config          = &config;
+    QueryPerformanceFrequency(&frequency);
+
+    do
+    {
+        for ( ; spawned < SRVC_TAME_CHECK_SLICED; spawned++ )
+        {
+            if ( Tamer_CheckSpawn("memory 16", &agents[spawned], false) == false )
+                break;
+        }
+
+        if ( spawned < SRVC_TAME_CHECK_SLICED )
+            break;
+
+        Sleep(1000);
+        for ( int i = 0; i < spawned; i++ )
+            Tamer_SliceQueue(agents[i].dwProcessId);
+
+        QueryPerformanceCounter(&start);
+        Tamer_SliceFlush();
+        QueryPerformanceCounter(&end);
+
+        if ( gTamer.slice.hJob == NULL ||
+             QueryInformationJobObject(gTamer.slice.hJob, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL) == FALSE ||
+             QueryInformationJobObject(gTamer.slice.hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL) == FALSE ||
+             QueryInformationJobObject(gTamer.slice.hJob, JobObjectCpuRateControlInformation, &cpuRate, sizeof(cpuRate), NULL) == FALSE )
+            break;
+
+        retVal = accounting.ActiveProcesses == (DWORD) spawned && gTamer.slice.assigned == (uint64_t) spawned;
+        for ( int i = 0; i < spawned; i++ )
+            retVal = retVal && IsProcessInJob(agents[i].hProcess, gTamer.slice.hJob, &inJob) && inJob;
+
+        retVal = retVal && (cpuRate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED) && cpuRate.Weight == config.sliceCpuWeight &&
+                 (limits.BasicLimitInformation.LimitFlags & JOB_OBJECT_LIMIT_WORKINGSET) &&
+                 limits.BasicLimitInformation.MaximumWorkingSetSize == (SIZE_T) config.sliceMemoryHigh * 1024 * 1024;
+
+        Sleep(500);
+        for ( int i = 0; i < spawned; i++ )
+        {
+            if ( GetProcessMemoryInfo(agents[i].hProcess, &counters, sizeof(counters)) && counters.WorkingSetSize > workingSet )
+                workingSet = counters.WorkingSetSize;
+        }
+
+        printf("Slice: %d agents moved in one batch, %.1f us each, weight %lu, working set ceiling %u MB, largest agent working set %llu MB\n", spawned,
+               (double) (end.QuadPart - start.QuadPart) * 1000000.0 / (double) frequency.QuadPart / spawned, (unsigned long) cpuRate.Weight,
+               config.sliceMemoryHigh, (unsigned long long) (workingSet >> 20));
+
+        /* Already in, the next sweeps find them there */
+        assigned = gTamer.slice.assigned;
+        for ( int i = 0; i < spawned; i++ )
+            Tamer_SliceQueue(agents[i].dwProcessId);
+
+        Tamer_SliceFlush();
+        retVal = retVal && gTamer.slice.assigned == assigned;
+
+        Tamer_SliceReset();
+        retVal = retVal && QueryInformationJobObject(gTamer.slice.hJob, JobObjectCpuRateControlInformation, &cpuRate, sizeof(cpuRate), NULL) &&
+                 cpuRate.ControlFlags == 0;
+
+    } while ( 0 );
+
+    /* Cleanup section */
+    for ( int i = 0; i < spawned; i++ )
+        Tamer_CheckKill(&agents[i]);
+
+    if ( gTamer.slice.hJob != NULL )
+        CloseHandle(gTamer.slice.hJob);
+
+    free(gTamer.slice.queue);
+    memset(&gTamer.slice, 0, sizeof(gTamer.slice));
+    gTamer.config = saved;
+
+    printf("Slice: %s\n", retVal ? "passed" : "FAILED");
+    return retVal;
 }
 
 /**
- * @brief Main processing loop for the service.
- * @retval bool true to continue processing, false to indicate a stop condition.
+ * @brief Console self checks, each measuring what its feature is there for.
+ * @retval int EXIT_SUCCESS when every check passed, EXIT_FAILURE otherwise.
  */
 
-static bool Tamer_ServiceProcess(void)
+static int Tamer_SelfCheck(void)
 {
-    Tamer_Proc *el;
+    bool passed = true;
 
-    /* Update configuration as needed */
-    if ( Tamer_ReadConfig() == 0 )
-        return false;
+    Tamer_NtInit();
 
-    if ( gTamer.config == NULL || gTamer.config->procList == NULL )
-        return false;
+    passed &= Tamer_CheckCpuCap();
+    passed &= Tamer_CheckHandleCache();
+    passed &= Tamer_CheckIoPriority();
+    passed &= Tamer_CheckSerialize();
+    passed &= Tamer_CheckPidTable();
+    passed &= Tamer_CheckTrim();
+    passed &= Tamer_CheckSlice();
 
-    LL_FOREACH(gTamer.config->procList, el)
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Wait for the next sweep: the interval, or earlier once process creations or exits are reported.
+ * Only the processes of entry jobs are reported, the job notifications being the one event source.
+ * Events arriving in a burst are coalesced into a single sweep. After the first one the
+ * loop keeps waiting as long as others follow within the window, up to 'CoalesceMax' ms in
+ * total. The window adapts to the arrival rate: a batch of several events doubles it for
+ * the next burst, a lone one halves it, so isolated processes are tamed within a few ms
+ * while a storm of thousands costs a handful of sweeps. Whatever the event rate, early
+ * sweeps start at least 'CoalesceMax' ms apart.
+ */
+
+static void Tamer_Wait(void)
+{
+    ULONGLONG start, elapsed, gap;
+    uint64_t  batch = 0;
+    DWORD     remaining;
+    HANDLE    handles[2];
+
+    if ( gTamer.wake.hEvent == NULL && gTamer.config->coalesceMax > 0 )
     {
-        Tamer_SetProcessPriority(el);
+        gTamer.wake.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        gTamer.wake.window = SRVC_TAME_COALESCE_MIN;
     }
-    return true;
+
+    /* A stop request ends the wait right away */
+    if ( gTamer.wake.hEvent == NULL || gTamer.config->coalesceMax == 0 )
+    {
+        if ( gTamer.hStop != NULL )
+            WaitForSingleObject(gTamer.hStop, gTamer.config->interval);
+        else
+            Sleep(gTamer.config->interval);
+        return;
+    }
+
+    /* Interval elapsed without any creation reported */
+    handles[0] = gTamer.wake.hEvent;
+    handles[1] = gTamer.hStop;
+    if ( WaitForMultipleObjects(gTamer.hStop != NULL ? 2 : 1, handles, FALSE, gTamer.config->interval) != WAIT_OBJECT_0 )
+        return;
+
+    start = GetTickCount64();
+    do
+    {
+        batch += (uint64_t) InterlockedExchange(&gTamer.wake.pending, 0);
+        elapsed = GetTickCount64() - start;
+        if ( elapsed >= gTamer.config->coalesceMax )
+            break;
+
+        remaining = (DWORD) (gTamer.config->coalesceMax - elapsed);
+    } while ( WaitForSingleObject(gTamer.wake.hEvent, gTamer.wake.window < remaining ? gTamer.wake.window : remaining) == WAIT_OBJECT_0 );
+
+    /* Events keep piling up meanwhile, the sweep that follows covers them too */
+    gap     = gTamer.config->coalesceMax;
+    elapsed = GetTickCount64() - gTamer.sweepTick;
+    if ( elapsed < gap )
+    {
+        if ( gTamer.hStop != NULL )
+            WaitForSingleObject(gTamer.hStop, (DWORD) (gap - elapsed));
+        else
+            Sleep((DWORD) (gap - elapsed));
+
+        gTamer.wake.throttled++;
+    }
+
+    batch += (uint64_t) InterlockedExchange(&gTamer.wake.pending, 0);
+
+    if ( batch > 1 )
+        gTamer.wake.window = gTamer.wake.window * 2 < gTamer.config->coalesceMax ? gTamer.wake.window * 2 : gTamer.config->coalesceMax;
+    else if ( gTamer.wake.window > SRVC_TAME_COALESCE_MIN )
+        gTamer.wake.window /= 2;
+
+    gTamer.wake.wakes++;
+    gTamer.wake.events += batch;
+    gTamer.wake.exits += (uint64_t) InterlockedExchange(&gTamer.wake.exited, 0);
+    if ( batch > gTamer.wake.maxBatch )
+        gTamer.wake.maxBatch = batch;
 }
 
 /**
@@ -499,7 +7003,8 @@ bool Tamer_ServiceMain(int argc, char **argv)
         return false;
     }
 
-    if ( Tamer_ServiceInit() == false )
+    gTamer.hStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if ( gTamer.hStop == NULL || Tamer_ServiceInit() == false )
     {
         gTamer.ServiceStatus.dwCurrentState  = SERVICE_STOPPED;
         gTamer.ServiceStatus.dwWin32ExitCode = -1;
@@ -513,9 +7018,20 @@ bool Tamer_ServiceMain(int argc, char **argv)
     while ( gTamer.ServiceStatus.dwCurrentState == SERVICE_RUNNING )
     {
         Tamer_ServiceProcess();
-        Sleep(gTamer.config->interval);
+        Tamer_Wait();
     }
 
+    /* Frozen and contained processes must not outlive the service */
+    Tamer_LimitReset();
+    Tamer_JobsReset();
+    Tamer_SliceReset();
+
+    gTamer.ServiceStatus.dwCurrentState = SERVICE_STOPPED;
+    gTamer.ServiceStatus.dwWaitHint     = 0;
+    SetServiceStatus(gTamer.hStatus, &gTamer.ServiceStatus);
+    CloseHandle(gTamer.hStop);
+    gTamer.hStop = NULL;
+
     return true;
 }
 
@@ -532,6 +7048,14 @@ int main(int argc, char *argv[])
 
     gTamer.serviceMode = SRVC_TAME_RUN_AS_SERVICE;
 
+    /* Load generating child processes of the self checks */
+    if ( argc >= 3 && _stricmp(argv[1], "-t") == 0 )
+        return Tamer_CheckChild(argc - 2, argv + 2);
+
+    /* Lint and dry run may try a configuration file other than the one in use, before it is deployed */
+    if ( argc == 3 && (_stricmp(argv[1], "-l") == 0 || _stricmp(argv[1], "-d") == 0) )
+        gTamer.configFile = argv[2];
+
     /* Read the configuration (.ini) file */
     if ( Tamer_ReadConfig() == 0 )
     {
@@ -544,7 +7068,13 @@ int main(int argc, char *argv[])
     }
 
     /* Handle service install/ uninstall from the command line */
-    if ( argc == 2 )
+    if ( (argc == 2 || argc == 3) && _stricmp(argv[1], "-d") == 0 )
+    {
+        /* Dry run, the console loop below decides as the service would without acting, from the state the service left */
+        gTamer.serviceMode = false;
+        gTamer.dryRun      = true;
+    }
+    else if ( argc == 2 || gTamer.configFile != NULL )
     {
         if ( _stricmp(argv[1], "-i") == 0 )
         {
@@ -554,6 +7084,14 @@ int main(int argc, char *argv[])
         {
             retVal = Tamer_ServiceUninstall(SRVC_TAME_SERVICE_NAME);
         }
+        else if ( _stricmp(argv[1], "-l") == 0 )
+        {
+            return Tamer_Lint();
+        }
+        else if ( _stricmp(argv[1], "-t") == 0 )
+        {
+            return Tamer_SelfCheck();
+        }
         else
         {
             printf("Unknown command line option provided.\n");
@@ -583,11 +7121,23 @@ int main(int argc, char *argv[])
     else
     {
         /* Running as a stand alone console process */
-        while ( 1 )
+        gTamer.hStop    = CreateEvent(NULL, TRUE, FALSE, NULL);
+        gTamer.hStopped = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if ( gTamer.hStop == NULL || gTamer.hStopped == NULL )
+            return EXIT_FAILURE;
+
+        SetConsoleCtrlHandler(Tamer_ConsoleControl, TRUE);
+        while ( WaitForSingleObject(gTamer.hStop, 0) != WAIT_OBJECT_0 )
         {
             Tamer_ServiceProcess();
-            Sleep(gTamer.config->interval);
+            Tamer_Wait();
         }
+
+        /* Frozen and contained processes must not outlive the console process */
+        Tamer_LimitReset();
+        Tamer_JobsReset();
+        Tamer_SliceReset();
+        SetEvent(gTamer.hStopped);
     }
 
     return EXIT_SUCCESS;
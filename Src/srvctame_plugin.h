@@ -0,0 +1,114 @@
+/**
+ ******************************************************************************
+ *
+ * @file    srvctame_plugin.h
+ * @brief   Process Tamer plugin interface.
+ *
+ ******************************************************************************
+ *
+ * A plugin is a DLL listed in the [Plugins] section of the configuration file:
+ *
+ *    [Plugins]
+ *    Plugin1_Path=C:\Tools\NotifySupervisor.dll
+ *
+ * It exports SRVC_TAME_PLUGIN_ENTRY, which fills a SrvcTame_Plugin structure.
+ * Configuration entries refer to a plugin by its name (Process%d_Plugin=<name>):
+ *
+ * - The optional 'match' predicate becomes an extra condition of those entries.
+ * - The optional 'batch' handler receives, once per check, every process whose
+ *   combined action includes the plugin. It is never called per process.
+ *
+ * Both callbacks run on the service thread that applies the actions, and are
+ * timed. A plugin whose callbacks keep exceeding the configured budget per check
+ * (PluginBudget, milliseconds) is disabled, and its entries stop matching.
+ *
+ ******************************************************************************
+ */
+
+#ifndef SRVC_TAME_PLUGIN_H
+#define SRVC_TAME_PLUGIN_H
+
+#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @addtogroup SRVC_TAME_PLUGIN
+  * @{
+  */
+
+#define SRVC_TAME_PLUGIN_VERSION 2                         /* Bumped whenever the structures below change */
+#define SRVC_TAME_PLUGIN_ENTRY   "SrvcTame_PluginRegister" /* Name of the exported registration function */
+
+/* Action fields, an entry sets some of them and the service merges them per process */
+#define TAMER_ACTION_PRIORITY          0x00000001 /* Priority class */
+#define TAMER_ACTION_AFFINITY          0x00000002 /* Confine to the housekeeping processors */
+#define TAMER_ACTION_ECOQOS            0x00000004 /* Power throttling, efficient processors at low frequency */
+#define TAMER_ACTION_IOPRIO            0x00000008 /* I/O priority hint */
+#define TAMER_ACTION_PLUGIN            0x00000010 /* Handed to a plugin batch handler */
+#define TAMER_ACTION_THREADS           0x00000020 /* Priority applied to the threads matching a name pattern only */
+#define TAMER_ACTION_LIMIT             0x00000040 /* Counted against an instances limit, frozen beyond it */
+#define TAMER_ACTION_SERIALIZE         0x00000080 /* Member of a group whose processes take turns to run */
+#define TAMER_ACTION_JOB               0x00000100 /* Process tree placed in the job object of its entry */
+#define TAMER_ACTION_MEMPRIO           0x00000200 /* Memory priority, low priority pages leave memory first */
+#define TAMER_ACTION_TRIM              0x00000400 /* Working set emptied whenever the process is idle */
+#define TAMER_ACTION_SLICE             0x00000800 /* Moved into the shared background job object */
+#define TAMER_ACTION_ALL               0x00000FFF
+
+/*! @brief  Process as handed to a plugin */
+typedef struct __SrvcTame_PluginProcess
+{
+    DWORD    pid;
+    DWORD    parentPid;
+    uint32_t actions; /* Other actions applied to the process, TAMER_ACTION_xxx, 0 when asked by the match predicate */
+    char     exeName[MAX_PATH];
+
+} SrvcTame_PluginProcess;
+
+/**
+ * @brief Match predicate, an extra condition for the entries referring to the plugin.
+ * @param context Plugin context, as set at registration.
+ * @param process Pointer to the candidate process.
+ * @retval bool true if the process matches.
+ */
+typedef bool (*SrvcTame_PluginMatch)(void *context, const SrvcTame_PluginProcess *process);
+
+/**
+ * @brief Action handler, called once per check with all the processes the plugin acts upon.
+ * @param context Plugin context, as set at registration.
+ * @param batch Array of processes, valid during the call only.
+ * @param count Number of processes in the array.
+ */
+typedef void (*SrvcTame_PluginBatch)(void *context, const SrvcTame_PluginProcess *batch, size_t count);
+
+/*! @brief  Registration data filled by the plugin */
+typedef struct __SrvcTame_Plugin
+{
+    uint32_t             version; /* Must be SRVC_TAME_PLUGIN_VERSION */
+    char                 name[64];
+    void                *context;
+    SrvcTame_PluginMatch match; /* Optional */
+    SrvcTame_PluginBatch batch; /* Optional */
+
+} SrvcTame_Plugin;
+
+/**
+ * @brief Registration function exported by the plugin as SRVC_TAME_PLUGIN_ENTRY.
+ * @param plugin Pointer to the structure to fill, zeroed by the caller.
+ * @retval bool true if the plugin is usable.
+ */
+typedef bool (*SrvcTame_PluginRegister)(SrvcTame_Plugin *plugin);
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRVC_TAME_PLUGIN_H */